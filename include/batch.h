@@ -0,0 +1,47 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "measurement.h"
+
+#include <stdint.h>
+
+/**
+ * Buffers measurements in RTC memory so several wake cycles can be uploaded to
+ * InfluxDB in a single request, with the WiFi kept off in between
+ *
+ * Points are kept in a fixed-size ring buffer of INFLUXDB_BATCH_CAPACITY entries
+ * that survives deep sleep. When the buffer is full, the oldest point moves on to the
+ * flash outbox (see outbox.h), or is dropped without one.
+ * Every point carries the time it was captured, so InfluxDB stores it at the right
+ * place in the series even though it arrives later.
+ */
+
+/**
+ * Appends the measurement to the buffer, with the capture time it carries
+ */
+void batch_add(const Measurement& measurement);
+
+/**
+ * Tells whether the buffer should be uploaded this cycle
+ *
+ * @param cycles Number of cycles uploaded together (INFLUXDB_BATCH_CYCLES, or more to save power)
+ * @param pending Points that are going to be added before the upload
+ * @return true once `cycles` points are buffered, or when the buffer is nearly full
+ */
+bool batch_flush_due(uint8_t cycles, uint8_t pending = 0);
+
+/**
+ * Uploads all buffered points as one multi-line InfluxDB write
+ *
+ * @note Requires active WiFi connection. The buffer is only cleared when InfluxDB accepts the write.
+ * @param timeout_ms Limit for the HTTP connect and response waits
+ * @return true if the points were written
+ */
+bool batch_flush(uint32_t timeout_ms);
+
+/**
+ * Number of points currently buffered
+ */
+uint8_t batch_count();
+
+#endif // BATCH_H
@@ -0,0 +1,65 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * Wall-clock time across deep sleep
+ *
+ * The ESP32 keeps its system time running through deep sleep on the RTC slow
+ * clock, which is only calibrated to within a few hundred ppm and moves with
+ * temperature: minutes a week. Rather than asking SNTP every wake, the clock is
+ * synchronized every CLOCK_SYNC_INTERVAL_H on a wake that has the radio on
+ * anyway. Each synchronization measures how far the clock went off over the deep
+ * sleep since the previous one; from that, the drift of the RTC is estimated and
+ * on every wake the system time is corrected by the drift over the sleep that
+ * just ended. time() is then wall-clock time to well within a second between
+ * synchronizations, and points are stamped when they are measured.
+ */
+
+/**
+ * The system time counts from power-on until the first SNTP synchronization.
+ * Anything below this is such an uptime rather than a wall-clock time (2023-11-14).
+ */
+#define VALID_EPOCH 1700000000
+
+/**
+ * Corrects the system time for the drift of the RTC over the deep sleep that
+ * just ended; call early in setup(), before anything is timestamped
+ */
+void clock_wake();
+
+/**
+ * Notes the length of the deep sleep about to start; call right before it
+ */
+void clock_sleep(uint64_t duration_us);
+
+/**
+ * Tells whether the clock is to be synchronized on this wake: it never was since
+ * power-on, or CLOCK_SYNC_INTERVAL_H passed (sooner while the drift is unknown)
+ */
+bool clock_sync_due();
+
+/**
+ * Tells whether time() is wall-clock time
+ */
+bool clock_synchronized();
+
+/**
+ * Synchronizes the system time over SNTP and updates the drift estimate
+ *
+ * @note Requires active WiFi connection.
+ * @param timeout_ms Limit for the SNTP wait, at most 5 s are used
+ * @return true if the clock was synchronized
+ */
+bool synchronize_clock(uint32_t timeout_ms);
+
+/**
+ * Seconds to add to a timestamp below VALID_EPOCH, taken before the first
+ * synchronization since power-on, to make it wall-clock time
+ *
+ * @return 0 if the clock has not been synchronized since power-on
+ */
+uint32_t clock_offset();
+
+#endif // CLOCK_H
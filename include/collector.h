@@ -0,0 +1,27 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include "measurement.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Sends the measurement to the local collector as one binary UDP datagram
+ * (see collector_packet.h), instead of text over HTTP
+ *
+ * With COLLECTOR_REQUEST_ACK enabled, the collector answers with an ACK; if none arrives
+ * within COLLECTOR_ACK_TIMEOUT_MS, the datagram is sent once more.
+ *
+ * @param timeout_ms Limit for the whole exchange, ACK waits included
+ * @return true if the datagram was sent and, with COLLECTOR_REQUEST_ACK, acknowledged
+ */
+bool send_to_collector(const Measurement& measurement, uint32_t timeout_ms);
+
+/**
+ * Sends log text to the collector as unacknowledged datagrams of at most
+ * COLLECTOR_LOG_CHUNK_SIZE bytes
+ */
+void send_log_to_collector(const char* text, size_t length);
+
+#endif // COLLECTOR_H
@@ -0,0 +1,142 @@
+#ifndef COLLECTOR_PACKET_H
+#define COLLECTOR_PACKET_H
+
+#include "payload_writer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Binary datagram format between a station and the local collector (tools/collector.cpp)
+ *
+ * All integers are little-endian. Every datagram starts with the same header and
+ * ends with a CRC-16/CCITT-FALSE over everything before it:
+ *
+ *     0  magic       u8   'W'
+ *     1  version     u8   COLLECTOR_PACKET_VERSION
+ *     2  type        u8   CollectorPacketType
+ *     3  flags       u8   COLLECTOR_FLAG_*
+ *     4  station_id  u32
+ *     8  sequence    u16  per station, echoed in the ACK
+ *    10  boot        u16  random, drawn when the station's sequence starts at 0; echoed in the ACK
+ *    12  body             depends on the type
+ *     n  crc         u16
+ *
+ * A point body is the capture time (u32, seconds since the Unix epoch, or since
+ * power-on before SNTP), the presence bitmask (u16, bits as Measurement::Field)
+ * and one scaled 16-bit integer per present field, in field order. Fields that
+ * follow from others (Fahrenheit, inHg, UV index) are not sent.
+ * An ACK has an empty body; a log body is text.
+ *
+ * The sequence is kept in RTC memory, which a power-on, brownout or reset
+ * clears. A new boot value tells the collector that the numbering started over,
+ * so it does not take the new datagrams for retransmissions.
+ *
+ * This file has no Arduino dependencies, so the collector can be built on the host.
+ */
+
+#define COLLECTOR_PACKET_MAGIC 'W'
+#define COLLECTOR_PACKET_VERSION 2
+#define COLLECTOR_FLAG_ACK_REQUESTED 0x01
+
+/**
+ * Must match Measurement::FIELD_COUNT (checked in collector.cpp)
+ */
+#define COLLECTOR_FIELD_COUNT 15
+
+#define COLLECTOR_HEADER_LENGTH 12
+#define COLLECTOR_CRC_LENGTH 2
+#define COLLECTOR_POINT_MAX_LENGTH (COLLECTOR_HEADER_LENGTH + 6 + 2 * COLLECTOR_FIELD_COUNT + COLLECTOR_CRC_LENGTH)
+#define COLLECTOR_ACK_LENGTH (COLLECTOR_HEADER_LENGTH + COLLECTOR_CRC_LENGTH)
+
+enum CollectorPacketType : uint8_t {
+    COLLECTOR_POINT = 1,
+    COLLECTOR_ACK = 2,
+    COLLECTOR_LOG = 3,
+};
+
+struct CollectorPoint {
+    uint32_t timestamp;
+    uint16_t present;
+    float values[COLLECTOR_FIELD_COUNT];
+};
+
+/**
+ * Header fields of a datagram, plus where its body is
+ */
+struct CollectorPacket {
+    CollectorPacketType type;
+    uint8_t flags;
+    uint32_t station_id;
+    uint16_t sequence;
+    uint16_t boot;
+    const uint8_t* body;
+    size_t body_length;
+};
+
+uint16_t crc16_ccitt(const uint8_t* data, size_t length);
+
+/**
+ * Encodes a point; values are rounded to the field's resolution and clamped to its range
+ *
+ * @return Length of the datagram, 0 if it does not fit
+ */
+size_t collector_encode_point(uint8_t* out, size_t capacity, uint32_t station_id, uint16_t boot, uint16_t sequence,
+    uint8_t flags, const CollectorPoint& point);
+
+/**
+ * Encodes an ACK for the datagram with the given station, boot and sequence
+ */
+size_t collector_encode_ack(uint8_t* out, size_t capacity, uint32_t station_id, uint16_t boot, uint16_t sequence);
+
+/**
+ * Encodes a chunk of log text
+ */
+size_t collector_encode_log(uint8_t* out, size_t capacity, uint32_t station_id, uint16_t boot, uint16_t sequence,
+    const char* text, size_t length);
+
+/**
+ * Checks magic, version, length and CRC of a datagram and splits off its header
+ *
+ * @return false if the datagram is malformed or from another version
+ */
+bool collector_decode(const uint8_t* data, size_t length, CollectorPacket& packet);
+
+/**
+ * Decodes the body of a COLLECTOR_POINT datagram
+ */
+bool collector_decode_point(const CollectorPacket& packet, CollectorPoint& point);
+
+/**
+ * Sequence numbers the collector keeps per station: the datagrams of several
+ * wakes, so that a retransmission is recognized also when a log chunk or another
+ * point came in between
+ */
+#define COLLECTOR_RECENT_SEQUENCES 32
+
+/**
+ * Datagrams seen recently from one station, to drop retransmissions whose ACK got
+ * lost; zero-initialized before the first datagram
+ */
+struct CollectorRecent {
+    uint16_t boot;
+    uint16_t sequences[COLLECTOR_RECENT_SEQUENCES]; // ring, newest at next - 1
+    uint8_t count;
+    uint8_t next;
+};
+
+/**
+ * Remembers the datagram's sequence number; a datagram from another boot of the
+ * station starts the window over
+ *
+ * @return true if it is a retransmission of a recent datagram
+ */
+bool collector_seen_recently(CollectorRecent& recent, const CollectorPacket& packet);
+
+/**
+ * Appends a point as InfluxDB line protocol, with the same measurement and field
+ * names as write_line_protocol() and the station ID as a tag
+ */
+void collector_write_line_protocol(PayloadWriter& line, uint32_t station_id, const CollectorPoint& point);
+
+#endif // COLLECTOR_PACKET_H
@@ -0,0 +1,39 @@
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include "measurement.h"
+
+#include <stdint.h>
+
+/**
+ * Change-driven reporting
+ *
+ * A measurement is only reported (uploaded, or buffered for a batch upload) when
+ * a field moved beyond its deadband since the last reported measurement, kept in
+ * RTC memory. Every DEADBAND_HEARTBEAT_CYCLES cycles a measurement is reported
+ * regardless, so a quiet station is still seen to be alive. Between reports the
+ * stored series stays within the deadbands of the real values.
+ */
+
+/**
+ * Tells whether the measurement differs enough from the last reported one to be
+ * reported, or whether the heartbeat is due
+ *
+ * A field that appears counts as a change; a field that is missing this cycle
+ * (e.g. the SPS30 did not run) does not. Fields derived from others (Fahrenheit,
+ * inHg, dew point, UV index) are not compared themselves.
+ */
+bool deadband_exceeded(const Measurement& measurement);
+
+/**
+ * Makes the measurement the new reference and restarts the heartbeat count;
+ * call for every measurement that is reported
+ */
+void deadband_reported(const Measurement& measurement);
+
+/**
+ * Counts a cycle whose measurement was not reported
+ */
+void deadband_skipped();
+
+#endif // DEADBAND_H
@@ -0,0 +1,110 @@
+#ifndef FIELDS_H
+#define FIELDS_H
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * Registry of the measured and derived fields
+ *
+ * One row per Measurement::Field, in the same order, tells everything the code
+ * needs to know about the field: how it is validated, printed, written to
+ * InfluxDB, sent to Weather Underground and the collector, and which deadband
+ * applies. Adding a sensor value takes a new Measurement::Field and a new row here.
+ *
+ * This file has no Arduino dependencies, so the collector can be built on the host.
+ */
+
+/**
+ * Physical quantity of a field, which selects its deadband (DEADBAND_* in env.h);
+ * derived fields follow from others and have none
+ */
+enum FieldQuantity : uint8_t {
+    QUANTITY_DERIVED,
+    QUANTITY_TEMPERATURE,
+    QUANTITY_HUMIDITY,
+    QUANTITY_PRESSURE,
+    QUANTITY_ILLUMINATION,
+    QUANTITY_VOLTAGE,
+    QUANTITY_PARTICULATE_MATTER,
+    QUANTITY_COUNT
+};
+
+/**
+ * `alternate` of a field that is not shown in other units
+ */
+#define FIELD_NO_ALTERNATE 0xff
+
+struct FieldDescriptor {
+    const char* label; // in the log; nullptr: only printed as another field's alternate
+    const char* unit;
+    float min; // readings outside [min, max] are dropped
+    float max;
+    uint8_t decimals; // in the log, in line protocol and in the Weather Underground URL
+    uint8_t alternate; // the same value in other units, printed after this one
+    const char* influx_name; // nullptr: not written to InfluxDB
+    const char* wunderground_name; // nullptr: not sent to Weather Underground
+    float collector_scale; // wire encoding: value * scale as int16 or uint16; 0: not sent
+    bool collector_signed;
+    FieldQuantity quantity;
+};
+
+/*
+    BMP280 (pressure):
+        https://www.alldatasheet.com/datasheet-pdf/view/1132069/BOSCH/BMP280.html
+    AHT20 (temperature and humidity):
+        https://static.maritex.eu/file/display/RNvX5GenZti93oVcmXPk9n_PKbFzX2F0/AHT20.pdf
+    BH1750 (illumination):
+        https://www.handsontec.com/dataspecs/sensor/BH1750%20Light%20Sensor.pdf
+    SPS30 (particulate matter):
+        https://sensirion.com/media/documents/8600FF88/64A3B8D6/Sensirion_PM_Sensors_Datasheet_SPS30.pdf
+*/
+// clang-format off
+constexpr FieldDescriptor field_descriptors[] = {
+    // label                  unit      min        max       dec alternate           InfluxDB               WU          scale  signed quantity
+    { "Temperature",          "°C",     -40,       85,       2,  1,                  "temperature",         nullptr,    100,   true,  QUANTITY_TEMPERATURE },        // TEMPERATURE_C
+    { nullptr,                "°F",     -INFINITY, INFINITY, 2,  FIELD_NO_ALTERNATE, nullptr,               "tempf",    0,     false, QUANTITY_DERIVED },            // TEMPERATURE_F
+    { "Humidity",             "%",      0,         100,      1,  FIELD_NO_ALTERNATE, "humidity",            "humidity", 100,   false, QUANTITY_HUMIDITY },           // HUMIDITY
+    { "Pressure",             "hPa",    300,       1100,     2,  4,                  "pressure",            nullptr,    10,    false, QUANTITY_PRESSURE },           // PRESSURE_HPA
+    { nullptr,                "inHg",   -INFINITY, INFINITY, 2,  FIELD_NO_ALTERNATE, nullptr,               "baromin",  0,     false, QUANTITY_DERIVED },            // PRESSURE_B
+    { "Dew Point",            "°C",     -INFINITY, INFINITY, 2,  6,                  "dew_point",           nullptr,    100,   true,  QUANTITY_DERIVED },            // DEW_POINT_C
+    { nullptr,                "°F",     -INFINITY, INFINITY, 2,  FIELD_NO_ALTERNATE, nullptr,               "dewptf",   0,     false, QUANTITY_DERIVED },            // DEW_POINT_F
+    { "Illumination",         "lx",     0,         65535,    1,  FIELD_NO_ALTERNATE, "illumination",        nullptr,    1,     false, QUANTITY_ILLUMINATION },       // ILLUMINATION
+    { "Battery voltage",      "V",      -INFINITY, INFINITY, 2,  FIELD_NO_ALTERNATE, "battery_voltage",     nullptr,    1000,  false, QUANTITY_VOLTAGE },            // BATTERY_VOLTAGE_A0
+    { "Solar panel voltage",  "V",      -INFINITY, INFINITY, 2,  FIELD_NO_ALTERNATE, "solar_panel_voltage", nullptr,    1000,  false, QUANTITY_VOLTAGE },            // SOLAR_PANEL_VOLTAGE_A1
+    { "UV voltage",           "V",      -INFINITY, INFINITY, 2,  FIELD_NO_ALTERNATE, "uv_voltage",          nullptr,    1000,  false, QUANTITY_VOLTAGE },            // UV_VOLTAGE_A2
+    { "UV Index",             "",       -INFINITY, INFINITY, 0,  FIELD_NO_ALTERNATE, nullptr,               nullptr,    0,     false, QUANTITY_DERIVED },            // UV_INDEX
+    { "MC PM1.0",             "ug/m3",  0,         1000,     2,  FIELD_NO_ALTERNATE, "mc_pm1_0",            nullptr,    10,    false, QUANTITY_PARTICULATE_MATTER }, // MC_PM1_0
+    { "MC PM2.5",             "ug/m3",  0,         1000,     2,  FIELD_NO_ALTERNATE, "mc_pm2_5",            nullptr,    10,    false, QUANTITY_PARTICULATE_MATTER }, // MC_PM2_5
+    { "MC PM10.0",            "ug/m3",  0,         1000,     2,  FIELD_NO_ALTERNATE, "mc_pm10_0",           nullptr,    10,    false, QUANTITY_PARTICULATE_MATTER }, // MC_PM10_0
+};
+// clang-format on
+
+#define FIELD_DESCRIPTOR_COUNT (sizeof(field_descriptors) / sizeof(field_descriptors[0]))
+
+/**
+ * Tells whether every valid reading of a field survives the collector's 16-bit encoding
+ */
+constexpr bool collector_encoding_fits(const FieldDescriptor& field)
+{
+    if (field.collector_scale == 0 || field.min == -INFINITY || field.max == INFINITY)
+        return true;
+    float low = field.collector_signed ? -32768.0f : 0.0f;
+    float high = field.collector_signed ? 32767.0f : 65535.0f;
+    return field.min * field.collector_scale >= low && field.max * field.collector_scale <= high;
+}
+
+constexpr bool field_descriptors_valid()
+{
+    for (const FieldDescriptor& field : field_descriptors) {
+        if (field.min > field.max || !collector_encoding_fits(field))
+            return false;
+        if (field.alternate != FIELD_NO_ALTERNATE && field.alternate >= FIELD_DESCRIPTOR_COUNT)
+            return false;
+    }
+    return true;
+}
+
+static_assert(field_descriptors_valid(), "field_descriptors: empty range, collector scale overflowing 16 bits or bad alternate");
+
+#endif // FIELDS_H
@@ -0,0 +1,41 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Small-footprint gzip (RFC 1952) encoder for upload payloads
+ *
+ * The data is compressed as a single deflate block with the fixed Huffman codes
+ * (RFC 1951, 3.2.6), looking for repeats within the last GZIP_WINDOW_SIZE bytes.
+ * That is what line protocol needs: its field names repeat on every line, a few
+ * hundred bytes apart. The match tables take about 6 KB of static RAM instead of
+ * the few hundred KB of a full zlib compressor.
+ */
+
+/**
+ * Farthest back a repeat is looked for, a power of two
+ */
+#define GZIP_WINDOW_SIZE 2048
+
+/**
+ * Longest input gzip_compress() accepts
+ */
+#define GZIP_MAX_INPUT 65534
+
+/**
+ * Compresses a buffer into a gzip member
+ *
+ * @note Not reentrant: the match tables are static, callers have to serialize.
+ * @param capacity Size of `output`; compression is given up once it is exceeded
+ * @return Length of the gzip data, or 0 if it did not fit into `output` or the input is too long
+ */
+size_t gzip_compress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity);
+
+/**
+ * CRC-32 (IEEE 802.3) as used in the gzip trailer
+ */
+uint32_t crc32_ieee(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+#endif // GZIP_H
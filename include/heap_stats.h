@@ -0,0 +1,81 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include "perf.h"
+
+#include <sdkconfig.h>
+#include <stdint.h>
+
+/**
+ * Heap use per wake phase
+ *
+ * ESP-IDF reports each allocation to esp_heap_trace_alloc_hook() when built with
+ * CONFIG_HEAP_USE_HOOKS (pioarduino: `custom_sdkconfig = CONFIG_HEAP_USE_HOOKS=y`),
+ * as the host build always does. The hook runs for every allocation, also from
+ * ISRs and with the flash cache disabled, so it only counts allocations and
+ * bytes. Each phase (see perf_begin()) takes the difference of the counters over
+ * its run, which includes what other tasks allocated meanwhile. The heap is
+ * sampled at the start and the end of each run: how far the heap in use rose
+ * above where it was when the phase started, as far as the end or a new low-water
+ * mark of the heap shows, and the largest free block it left. Without the hook,
+ * only these samples are seen.
+ *
+ * Phases can have an allocation budget: the sensor path, the SPS30 task included,
+ * allocates nothing. It is checked on the runs during which no other task had a
+ * phase open, as only those allocations are the phase's own. The network phases
+ * are up to the WiFi, HTTP and UDP drivers, which allocate differently on the
+ * host, and are only reported. At the end of the cycle, the phases are logged and
+ * those over their budget are warned about; tools/wake_bench.cpp fails on them.
+ */
+
+struct HeapPhaseStats {
+    uint16_t allocations; // while the phase was open, by any task; saturates at 65535
+    uint16_t own_allocations; // in the runs without another task's phase open: checked against the budget
+    uint16_t own_runs; // runs without another task's phase open
+    uint32_t allocated_bytes;
+    uint32_t peak_bytes; // most heap in use above the start of the phase
+    uint32_t largest_free_block; // smallest at the end of the phase; 0: the phase did not run
+};
+
+/**
+ * Budget of a phase that is not checked
+ */
+#define HEAP_NO_BUDGET 0xffff
+
+/**
+ * Whether allocations are counted, rather than only the heap sampled at the
+ * start and end of each phase
+ */
+#if CONFIG_HEAP_USE_HOOKS
+#define HEAP_COUNTS_ALLOCATIONS 1
+#else
+#define HEAP_COUNTS_ALLOCATIONS 0
+#endif
+
+/**
+ * Starts accounting the allocations to `phase`; called by perf_begin()
+ */
+void heap_phase_begin(PerfPhase phase);
+
+/**
+ * Stops accounting to `phase`; called by perf_end()
+ */
+void heap_phase_end(PerfPhase phase);
+
+/**
+ * Logs the heap use of the phases of this cycle and warns about those over their
+ * budget; called by perf_finish_cycle()
+ */
+void heap_finish_cycle();
+
+/**
+ * Heap use of `phase` in this cycle, adding up if it ran several times
+ */
+const HeapPhaseStats& heap_phase_stats(PerfPhase phase);
+
+/**
+ * Most allocations `phase` may make in a cycle, HEAP_NO_BUDGET if any number
+ */
+uint16_t heap_allocation_budget(PerfPhase phase);
+
+#endif // HEAP_STATS_H
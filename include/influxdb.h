@@ -2,6 +2,7 @@
 #define INFLUXDB_H
 
 #include "measurement.h"
+#include "payload_writer.h"
 #include "utils.h"
 
 /**
@@ -15,7 +16,39 @@
  *
  * @note Requires active WiFi connection. Function will log error if WiFi disconnected.
  * @note Uses InfluxDB API v2 with token-based authentication.
+ * @param timeout_ms Limit for the HTTP connect and response waits
+ * @return true if InfluxDB accepted the write
  */
-void send_to_influx_db(const Measurement& measurement);
+bool send_to_influx_db(const Measurement& measurement, uint32_t timeout_ms);
+
+/**
+ * Longest line write_line_protocol() produces: all fields at their widest, plus the timestamp
+ */
+#define INFLUXDB_LINE_MAX_LENGTH 320
+
+/**
+ * Appends a measurement as a single line of InfluxDB line protocol, without the trailing newline
+ *
+ * The line ends with the capture time of the measurement in seconds since the
+ * Unix epoch; before the first clock synchronization, the server's arrival time is used.
+ *
+ * @param line Writer the line is appended to
+ * @param measurement Values to format, missing values are left out
+ */
+void write_line_protocol(PayloadWriter& line, const Measurement& measurement);
+
+/**
+ * Writes a line protocol payload, one point per line, to InfluxDB
+ *
+ * Payloads of INFLUXDB_GZIP_MIN_BYTES and more are sent gzip-compressed. Writes in
+ * the same wake reuse the connection of the previous one (keep-alive), so with an
+ * https:// INFLUXDB_HOSTNAME only the first pays for the TLS handshake. There is
+ * one such connection: writes from concurrent upload tasks wait for each other.
+ *
+ * @note Requires active WiFi connection. Function will log error if WiFi disconnected.
+ * @param timeout_ms Limit for the wait for the connection and the HTTP connect and response waits
+ * @return true if InfluxDB accepted the write
+ */
+bool post_to_influx_db(const char* payload, size_t length, uint32_t timeout_ms);
 
 #endif // INFLUXDB_H
@@ -0,0 +1,92 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "env.h"
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/**
+ * Serial output of the log (LOG_SERIAL in env.h); the log ring buffer gets every
+ * line in any case
+ */
+#define LOG_SERIAL_OFF 0 // Serial is not even started
+#define LOG_SERIAL_NON_BLOCKING 1 // lines go out in the background, those that do not fit the UART buffer are skipped
+#define LOG_SERIAL_BLOCKING 2 // every line, waiting for the UART; setup() waits for the port to open
+
+#ifndef LOG_SERIAL
+#define LOG_SERIAL LOG_SERIAL_BLOCKING
+#endif
+
+/**
+ * Logging macros, printf-style
+ *
+ * Messages above LOG_LEVEL are discarded at compile time: the condition is a
+ * constant, so the call and its format string are optimized out, while the
+ * arguments are still type-checked.
+ */
+#define LOG_AT(level, ...)                       \
+    do {                                         \
+        if ((level) <= LOG_LEVEL)                \
+            log_message((level), __VA_ARGS__);   \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/**
+ * Longest message kept; longer ones are cut off
+ */
+#define LOG_LINE_MAX_LENGTH 192
+
+/**
+ * Every line starts with its level's initial and a space: "E ", "W ", "I " or "D "
+ */
+#define LOG_LINE_PREFIX_LENGTH 2
+
+/**
+ * Starts the serial output as set by LOG_SERIAL; call once, first thing in setup()
+ */
+void log_begin();
+
+/**
+ * Logs a message to both the serial output and the log ring buffer, prefixed with its level
+ *
+ * The ring buffer has a fixed size of LOG_BUFFER_SIZE bytes. When it is full, the
+ * oldest lines are dropped, so memory use does not depend on how much a cycle logs.
+ * With LOG_PERSIST_IN_RTC enabled it lives in RTC memory, and lines from cycles
+ * that did not send the log are kept until the next send_log().
+ *
+ * Use the LOG_* macros rather than calling this directly. Safe to call from several tasks.
+ */
+void log_message(uint8_t level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * Number of bytes currently held in the log ring buffer
+ */
+size_t log_length();
+
+/**
+ * Sends accumulated log messages to a remote log server
+ *
+ * The ring buffer is streamed to the socket as it is, without building a request
+ * in memory, and cleared once sent. With LOG_TO_COLLECTOR enabled, it goes to the
+ * local collector as UDP datagrams instead of an HTTP POST to LOG_SERVER_HOST.
+ *
+ * @note Connection failures are logged but do not block execution
+ */
+void send_log();
+
+#endif // LOG_H
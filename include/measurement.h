@@ -7,43 +7,92 @@
 #include <BH1750.h>
 #include <SensirionI2cSps30.h>
 
-#include <memory>
+#include "fields.h"
+
+#include <stdint.h>
+#include <type_traits>
 
 /**
  * Represents a measurement of various weather parameters
  *
- * This struct holds smart pointers to values for different weather data.
- * Using std::unique_ptr makes sure the memory is cleaned up automatically.
- * If a pointer is null, it means that the measurement was not taken or is invalid.
+ * This struct holds the values for different weather data in a fixed array, with
+ * a bitmask telling which of them are present. If a value is not present, it means
+ * that the measurement was not taken or is invalid.
+ *
+ * Each measurement carries the time its sensors were read, so it can be uploaded
+ * later or in a batch and still land at the right place in the series.
+ *
+ * The struct is plain data (68 bytes), so it can be kept in RTC memory and copied
+ * around with memcpy, and reading sensors does not touch the heap.
  */
 struct Measurement {
-    std::unique_ptr<float> temperature_c;
-    std::unique_ptr<float> temperature_f;
-    std::unique_ptr<float> humidity;
-    std::unique_ptr<float> pressure_hpa;
-    std::unique_ptr<float> pressure_b;
-    std::unique_ptr<float> dew_point_c;
-    std::unique_ptr<float> dew_point_f;
-    std::unique_ptr<float> illumination;
-    std::unique_ptr<float> battery_voltage_a0;
-    std::unique_ptr<float> solar_panel_voltage_a1;
-    std::unique_ptr<float> uv_voltage_a2;
-    std::unique_ptr<int> uv_index;
-	std::unique_ptr<float> mc_pm1_0;
-	std::unique_ptr<float> mc_pm2_5;
-	std::unique_ptr<float> mc_pm10_0;
-
-    Measurement();
+    enum Field : uint8_t {
+        TEMPERATURE_C,
+        TEMPERATURE_F,
+        HUMIDITY,
+        PRESSURE_HPA,
+        PRESSURE_B,
+        DEW_POINT_C,
+        DEW_POINT_F,
+        ILLUMINATION,
+        BATTERY_VOLTAGE_A0,
+        SOLAR_PANEL_VOLTAGE_A1,
+        UV_VOLTAGE_A2,
+        UV_INDEX,
+        MC_PM1_0,
+        MC_PM2_5,
+        MC_PM10_0,
+        FIELD_COUNT
+    };
+
+    float values[FIELD_COUNT] = {};
+    uint16_t present = 0; // bit n set: values[n] holds a valid reading
+    uint32_t timestamp = 0; // time() when the sensors were read; below VALID_EPOCH before the first clock synchronization
+
+    bool has(Field field) const { return present & (1u << field); }
+    float get(Field field) const { return values[field]; }
+    void set(Field field, float value)
+    {
+        values[field] = value;
+        present |= 1u << field;
+    }
+    void clear(Field field) { present &= ~(1u << field); }
+
+    /**
+     * Starts the SPS30 measurement in a background task if it is due this cycle
+     *
+     * The sensor object must stay alive until finish_particulate_matter_reading().
+     */
+    void start_particulate_matter_reading(SensirionI2cSps30& sps30_sensor);
+    /**
+     * Estimated time until the background SPS30 measurement is done, 0 if none is running
+     */
+    unsigned long particulate_matter_pending_ms() const;
+    /**
+     * Tells whether an SPS30 measurement was started this cycle and has not been finished yet
+     */
+    bool particulate_matter_in_progress() const;
+    /**
+     * Waits for the background SPS30 measurement, if one was started, and takes over its results
+     */
+    void finish_particulate_matter_reading();
+    /**
+     * Reads the I2C sensors due this cycle (schedule.h) and stamps the measurement
+     * with the current time
+     */
     void read_sensors_and_voltage(
         Adafruit_BMP280& bmp_sensor,
         Adafruit_AHTX0& aht_sensor,
         BH1750& light_meter,
-        Adafruit_ADS1115& ads_sensor,
-        SensirionI2cSps30& sps30_sensor);
+        Adafruit_ADS1115& ads_sensor);
     void remove_invalid_measurements();
     void calculate_derived_values();
     void print_all_values() const;
     bool has_sensor_data() const;
 };
 
+static_assert(std::is_trivially_copyable<Measurement>::value, "Measurement must stay plain data");
+static_assert(sizeof(Measurement) == 68, "Measurement layout changed");
+static_assert(FIELD_DESCRIPTOR_COUNT == Measurement::FIELD_COUNT, "fields.h is out of sync with Measurement::Field");
+
 #endif // MEASUREMENT_H
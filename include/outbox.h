@@ -0,0 +1,47 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include "measurement.h"
+
+#include <stdint.h>
+
+/**
+ * Keeps points that could not be uploaded in flash, so that they survive WiFi or
+ * server outages of days and even a power loss, and uploads them once InfluxDB is
+ * reachable again
+ *
+ * The outbox is a file on LittleFS holding a ring of OUTBOX_CAPACITY fixed-size
+ * records. Each record is a point in the compact encoding of the collector
+ * transport (collector_packet.h), with its CRC. When the outbox is full, the
+ * oldest point is dropped.
+ *
+ * That encoding stores each field as a scaled int16 or uint16 (collector_scale in
+ * fields.h), so points from the outbox arrive coarser than direct writes: pressure
+ * to 0.1 hPa instead of 2 decimals, particulate matter to 0.1 ug/m3.
+ *
+ * @note Needs a data partition for LittleFS; the default partition tables have one
+ * ("spiffs"). It is formatted on first use.
+ */
+
+/**
+ * Appends a point, with its capture time, also if that is from before the first
+ * clock synchronization
+ */
+void outbox_add(const Measurement& measurement);
+
+/**
+ * Number of points waiting in the outbox
+ */
+uint16_t outbox_count();
+
+/**
+ * Uploads the points to InfluxDB, oldest first, in multi-line writes of up to
+ * OUTBOX_DRAIN_BATCH points, until the outbox is empty or the time is up
+ *
+ * @note Requires active WiFi connection. Points are only removed once InfluxDB has accepted them.
+ * @param timeout_ms Limit for the whole drain
+ * @return true if the outbox is empty
+ */
+bool outbox_drain(uint32_t timeout_ms);
+
+#endif // OUTBOX_H
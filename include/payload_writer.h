@@ -0,0 +1,60 @@
+#ifndef PAYLOAD_WRITER_H
+#define PAYLOAD_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Builds request payloads (URLs, line protocol, ...) in a caller-provided buffer
+ *
+ * Nothing is allocated on the heap. Appends that do not fit are cut off and
+ * remembered, so a payload can be built with unchecked appends and validated once
+ * with overflowed(). The buffer is always NUL-terminated.
+ *
+ * This file has no Arduino dependencies, so it can also be built on the host.
+ */
+class PayloadWriter {
+public:
+    PayloadWriter(char* buffer, size_t capacity);
+
+    PayloadWriter& append(const char* text);
+    PayloadWriter& append(const char* data, size_t length);
+    PayloadWriter& append(char c);
+    PayloadWriter& append(int32_t value);
+    PayloadWriter& append(uint32_t value);
+    PayloadWriter& append(float value, uint8_t decimals);
+
+    void clear();
+    const char* c_str() const { return buffer_; }
+    size_t length() const { return length_; }
+    size_t capacity() const { return capacity_; }
+    bool overflowed() const { return overflowed_; }
+
+private:
+    char* buffer_;
+    size_t capacity_; // including the terminating NUL
+    size_t length_;
+    bool overflowed_;
+};
+
+/**
+ * Longest text format_fixed() produces: sign, 10 integer digits, point, 6 decimals
+ */
+#define FORMAT_FIXED_MAX_LENGTH 18
+
+/**
+ * Formats a float with a fixed number of decimals, like String(value, decimals)
+ *
+ * Uses integer arithmetic on the scaled value instead of printf. The value is
+ * rounded half away from zero in single precision, so a value sitting exactly on
+ * a rounding boundary may differ from printf in the last digit. Values of 2^32
+ * and above fall back to snprintf.
+ *
+ * @param out Buffer of at least FORMAT_FIXED_MAX_LENGTH characters, not NUL-terminated by this function
+ * @param value Value to format; NaN and infinities are written as "nan" and "inf"
+ * @param decimals Number of decimals, at most 6
+ * @return Number of characters written
+ */
+size_t format_fixed(char* out, float value, uint8_t decimals);
+
+#endif // PAYLOAD_WRITER_H
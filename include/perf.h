@@ -0,0 +1,106 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include "payload_writer.h"
+
+#include <stdint.h>
+
+/**
+ * Wake-cycle instrumentation
+ *
+ * Each phase of a wake cycle is timed in microseconds, and its heap use is
+ * accounted (see heap_stats.h); together with the heap watermarks, a cycle's
+ * timings form one PerfRecord. The records of the last
+ * PERF_HISTORY_SIZE cycles are kept in RTC memory until they are uploaded to
+ * InfluxDB as the firmware_perf measurement, one line per cycle.
+ */
+
+enum PerfPhase : uint8_t {
+    PERF_BOOT, // reset to the start of setup()
+    PERF_FIRST_I2C, // reset to the first sensor transaction on the I2C bus
+    PERF_BMP280_BEGIN,
+    PERF_BMP280_READ,
+    PERF_AHT20_BEGIN,
+    PERF_AHT20_READ,
+    PERF_BH1750_BEGIN,
+    PERF_BH1750_READ,
+    PERF_ADS1115_BEGIN,
+    PERF_ADS1115_READ,
+    PERF_SPS30_WARMUP, // wake-up, fan cleaning and stabilization, in the SPS30 task
+    PERF_SPS30_SAMPLING,
+    PERF_WIFI_CONNECT,
+    PERF_CLOCK_SYNC, // SNTP, on the few wakes it is due
+    PERF_WUNDERGROUND, // in the upload task
+    PERF_INFLUXDB, // in the upload task
+    PERF_COLLECTOR, // in the upload task
+    PERF_OUTBOX, // in the upload task
+    PERF_SEND_LOG,
+    PERF_ACTIVE, // reset to deep sleep
+    PERF_PHASE_COUNT
+};
+
+struct PerfRecord {
+    uint32_t timestamp; // end of the cycle, seconds since the Unix epoch (or since power-on before SNTP)
+    uint32_t phase_us[PERF_PHASE_COUNT];
+    uint32_t free_heap;
+    uint32_t min_free_heap; // lowest free heap since boot
+    uint32_t largest_free_block; // at the end of the cycle; far below free_heap: the heap is fragmented
+};
+
+/**
+ * Longest line perf_write_history() produces for one record
+ */
+#define PERF_LINE_MAX_LENGTH 640
+
+/**
+ * Starts timing a phase. A phase timed several times in a cycle adds up.
+ *
+ * @note Each phase must only be timed from one task.
+ */
+void perf_begin(PerfPhase phase);
+
+/**
+ * Stops timing a phase started with perf_begin()
+ */
+void perf_end(PerfPhase phase);
+
+/**
+ * Records the time from reset to now as PERF_BOOT; call first thing in setup()
+ */
+void perf_start_cycle();
+
+/**
+ * Records the time from reset to now as `phase`
+ */
+void perf_mark(PerfPhase phase);
+
+/**
+ * Completes the record of this cycle with the total active time and the heap
+ * watermarks, and appends it to the history; call right before deep sleep
+ */
+void perf_finish_cycle();
+
+/**
+ * Name of the phase as in the log; the firmware_perf field adds "_us"
+ */
+const char* perf_phase_name(PerfPhase phase);
+
+/**
+ * Appends the history as firmware_perf lines of InfluxDB line protocol, each
+ * preceded by a newline if the payload is not empty
+ *
+ * Records from before the clock was synchronized get no timestamp. InfluxDB would
+ * store all of them at the arrival time, overwriting each other, so only the
+ * newest of them is written.
+ *
+ * @return Number of records in the history that were written or skipped, to be
+ *         passed to perf_clear_history() once the write was accepted
+ */
+uint8_t perf_write_history(PayloadWriter& payload);
+
+/**
+ * Drops the oldest records from the history
+ */
+void perf_clear_history(uint8_t count);
+
+#endif // PERF_H
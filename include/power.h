@@ -0,0 +1,53 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include "measurement.h"
+
+#include <stdint.h>
+
+/**
+ * Battery- and solar-aware cycle scheduling
+ *
+ * The battery voltage is smoothed over several cycles and its trend tracked in
+ * RTC memory. A falling battery is judged by where the trend takes it within
+ * POWER_TREND_HORIZON_H hours, so the station starts saving before the voltage
+ * actually gets low, e.g. at dusk. Each tier trades data for energy:
+ *
+ * - normal: CYCLE_TIME_SEC, all sensors, uploads as configured
+ * - economy: POWER_ECONOMY_CYCLE_FACTOR times longer cycles, no SPS30, InfluxDB
+ *   uploads batched over at least POWER_ECONOMY_BATCH_CYCLES cycles
+ * - critical: POWER_CRITICAL_CYCLE_FACTOR times longer cycles, no SPS30 and no
+ *   radio at all; measurements are only buffered in RTC memory
+ *
+ * Stepping back up needs POWER_HYSTERESIS_V above the threshold, or the threshold
+ * with the solar panel charging, so the station does not flap between tiers.
+ */
+
+enum PowerTier : uint8_t { POWER_NORMAL, POWER_ECONOMY, POWER_CRITICAL };
+
+/**
+ * What a cycle in the current tier may do
+ */
+struct PowerPlan {
+    PowerTier tier;
+    uint32_t cycle_time_s;
+    uint8_t batch_cycles; // upload InfluxDB every N cycles, 1 = every cycle without buffering
+    bool particulate_matter; // run the SPS30
+    bool radio; // WiFi and uploads allowed
+};
+
+/**
+ * Plan of the current tier. Until power_update() runs in a cycle, this is the
+ * tier chosen by the previous cycle.
+ */
+PowerPlan power_plan();
+
+/**
+ * Feeds the battery and solar panel voltages of this cycle into the smoothed
+ * voltage and trend, and moves to another tier if needed
+ *
+ * @note Measurements without a battery voltage leave the state unchanged.
+ */
+void power_update(const Measurement& measurement);
+
+#endif // POWER_H
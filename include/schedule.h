@@ -0,0 +1,68 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "measurement.h"
+#include "power.h"
+
+#include <stdint.h>
+
+/**
+ * Per-sensor acquisition schedule
+ *
+ * Each job (a sensor read, or a maintenance task such as the SPS30 fan cleaning)
+ * has an interval in wake cycles, a phase offset and conditions, kept in a table
+ * in src/schedule.cpp. A job is due once its interval has passed since it last
+ * ran, the first time after power-on `offset` cycles in, and only on cycles that
+ * meet its conditions; a due job that is held back by them runs on the first
+ * cycle that meets them. RTC memory keeps the wake cycle count, when each job is
+ * due next and whether the last solar panel voltage showed daylight.
+ *
+ * The ADS1115 battery and solar panel voltages are not scheduled: the power tiers
+ * and the daylight condition depend on them every cycle.
+ */
+
+enum Job : uint8_t {
+    JOB_BMP280,
+    JOB_AHT20,
+    JOB_BH1750,
+    JOB_UV, // ADS1115 channel of the UV sensor
+    JOB_SPS30,
+    JOB_SPS30_CLEANING, // runs with the next SPS30 measurement once due
+    JOB_COUNT
+};
+
+/**
+ * Conditions a cycle has to meet for a job to run, or'ed together
+ */
+#define SCHEDULE_ALWAYS 0
+#define SCHEDULE_IN_DAYLIGHT 0x01 // the solar panel showed at least SCHEDULE_DAYLIGHT_SOLAR_V last cycle
+#define SCHEDULE_FULL_POWER 0x02 // the power tier allows the power-hungry sensors (PowerPlan::particulate_matter)
+
+/**
+ * Counts the wake cycle and logs the jobs due in it; call once per cycle before
+ * the sensors are read
+ *
+ * @param plan Plan of the power tier the cycle starts in
+ */
+void schedule_begin_cycle(const PowerPlan& plan);
+
+/**
+ * Tells whether `job` is to run this cycle
+ */
+bool schedule_due(Job job);
+
+/**
+ * Records that `job` ran this cycle, or was attempted, so it is due again after
+ * its interval
+ */
+void schedule_done(Job job);
+
+/**
+ * Takes whether it is daylight, for the next cycle, from the solar panel voltage
+ *
+ * @note Measurements without a solar panel voltage count as daylight, so nothing
+ * is held back for want of it.
+ */
+void schedule_update(const Measurement& measurement);
+
+#endif // SCHEDULE_H
@@ -0,0 +1,91 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include "payload_writer.h"
+
+#include <stdint.h>
+
+/**
+ * Presence and health of the I2C sensors
+ *
+ * For each sensor, RTC memory keeps the address it last answered at and how many
+ * probes in a row failed. A sensor that failed is only probed again after 1, 2, 4,
+ * ... skipped opportunities, up to SENSOR_BACKOFF_MAX_CYCLES, so a station with a
+ * partial sensor kit does not pay the failed probe and the driver's init delays
+ * every cycle. After a power-on, every sensor is probed again.
+ */
+
+enum Sensor : uint8_t {
+    SENSOR_BMP280,
+    SENSOR_AHT20,
+    SENSOR_BH1750,
+    SENSOR_ADS1115,
+    SENSOR_SPS30,
+    SENSOR_COUNT
+};
+
+/**
+ * Addresses a sensor can be strapped to, at most this many
+ */
+#define SENSOR_MAX_ADDRESSES 2
+
+/**
+ * Longest line sensor_write_health() produces
+ */
+#define SENSOR_HEALTH_LINE_MAX_LENGTH 256
+
+/**
+ * Tells whether the sensor is to be probed this opportunity, counting down its
+ * backoff if not
+ *
+ * @note Call once per opportunity (once per cycle, or once per scheduled SPS30 measurement).
+ */
+bool sensor_probe_due(Sensor sensor);
+
+/**
+ * Fills `addresses` with the addresses to try, the one the sensor last answered at first
+ *
+ * @return Number of addresses
+ */
+uint8_t sensor_probe_order(Sensor sensor, uint8_t addresses[SENSOR_MAX_ADDRESSES]);
+
+/**
+ * Records that the sensor answered at `address`, ending its failure streak
+ */
+void sensor_found(Sensor sensor, uint8_t address);
+
+/**
+ * Records a failed probe and schedules the next one
+ */
+void sensor_missing(Sensor sensor);
+
+/**
+ * Probes the sensor, if due, at each of its addresses with `begin(address)` until
+ * one succeeds, and records the result
+ *
+ * @return Whether the sensor answered and can be read this cycle
+ */
+template <typename Begin> bool sensor_begin(Sensor sensor, Begin begin)
+{
+    if (!sensor_probe_due(sensor))
+        return false;
+    uint8_t addresses[SENSOR_MAX_ADDRESSES];
+    uint8_t count = sensor_probe_order(sensor, addresses);
+    for (uint8_t i = 0; i < count; i++) {
+        if (begin(addresses[i])) {
+            sensor_found(sensor, addresses[i]);
+            return true;
+        }
+    }
+    sensor_missing(sensor);
+    return false;
+}
+
+/**
+ * Appends the health map as a firmware_sensors line of InfluxDB line protocol,
+ * preceded by a newline if the payload is not empty: per sensor the address it
+ * last answered at (0: never since power-on) and its current failure streak
+ */
+void sensor_write_health(PayloadWriter& payload);
+
+#endif // SENSOR_HEALTH_H
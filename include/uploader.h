@@ -0,0 +1,41 @@
+#ifndef UPLOADER_H
+#define UPLOADER_H
+
+#include <stdint.h>
+
+/**
+ * An upload to one external service
+ *
+ * @param context Pointer given to upload_start(), must stay valid until upload_wait() returns
+ * @param timeout_ms Time left until the upload deadline, to be used for the connect and response timeouts
+ * @return true if the service accepted the data
+ */
+typedef bool (*UploadSink)(void* context, uint32_t timeout_ms);
+
+/**
+ * Most uploads started in one wake cycle
+ */
+#define UPLOAD_MAX_SINKS 4
+
+/**
+ * Starts an upload in a background task, so that several services are contacted
+ * concurrently instead of one after the other
+ *
+ * @param name Short service name used in the log
+ * @param deadline_ms millis() value by which the upload has to be done
+ * @return false if the task could not be started; the sink is not called then
+ */
+bool upload_start(const char* name, UploadSink sink, void* context, unsigned long deadline_ms);
+
+/**
+ * Waits until all started uploads are done or the deadline has passed, and logs
+ * the latency and outcome of each
+ *
+ * Uploads still running at the deadline are abandoned: their result is ignored and
+ * deep sleep ends the task. Deleting it instead could leave lwIP or the log locked.
+ *
+ * @return true if every upload waited for succeeded
+ */
+bool upload_wait(unsigned long deadline_ms);
+
+#endif // UPLOADER_H
@@ -3,12 +3,7 @@
 
 #include <Arduino.h>
 
-extern String log_buffer;
-
-/**
- * Logs a message to both the serial output and an internal log buffer
- */
-void serial_log(String message);
+#include "log.h"
 
 /**
  * Isolates all RTC-capable GPIO pins to reduce power consumption
@@ -22,15 +17,24 @@ void isolate_all_rtc_gpio();
 
 /**
  * Establishes a WiFi connection using credentials from env.h
+ *
+ * With WIFI_FAST_CONNECT enabled, the access point and DHCP lease of the last
+ * connection are reused from RTC memory to skip the scan and DHCP. If that fails,
+ * the cache is dropped and a full connect is made. The connect latency is logged.
+ *
+ * @note On failure the radio is switched off and the next attempts are spaced out
+ * exponentially, see wifi_backoff_elapsed().
+ * @return true if connected
  */
-void connect_to_wifi();
+bool connect_to_wifi();
 
 /**
- * Sends accumulated log messages to a remote log server
+ * Tells whether a connect may be attempted this cycle; to be called once per cycle
  *
- * @note Connection failures are logged but do not block execution
+ * After n failed connects in a row, the next 2^(n-1) cycles skip the WiFi, up to
+ * WIFI_BACKOFF_MAX_CYCLES. A successful connect resets the backoff.
  */
-void send_log();
+bool wifi_backoff_elapsed();
 
 /**
  * Sends weather sensor data to a remote database via HTTP GET request
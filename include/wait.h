@@ -0,0 +1,68 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+#include <stdint.h>
+
+/**
+ * Waiting at low power
+ *
+ * wait_begin() sets up the chip's power management: whenever every task is
+ * blocked, the CPU drops from its full clock to 80 MHz, or goes into light sleep
+ * until the next timer where the SDK is built with automatic light sleep. Time in
+ * wait_for() and wait_until() is such blocked time, so the long SPS30 warm-up,
+ * cleaning and sampling waits run at a fraction of the full-clock current, while
+ * other tasks keep the clock up whenever they have work.
+ *
+ * The clock the waits use can be replaced, so code built on them can run on the
+ * host without real time passing.
+ */
+
+/**
+ * Default interval at which wait_until() checks its condition
+ */
+#define WAIT_POLL_MS 20
+
+struct WaitClock {
+    unsigned long (*now_ms)();
+    void (*sleep_ms)(uint32_t ms); // blocks the calling task
+};
+
+/**
+ * Enables dynamic frequency scaling and, where supported, automatic light sleep;
+ * call once, early in setup()
+ */
+void wait_begin();
+
+/**
+ * Replaces the clock of all waits; nullptr restores millis() and delay()
+ */
+void wait_set_clock(const WaitClock* clock);
+
+const WaitClock& wait_clock();
+
+/**
+ * Blocks the calling task for `duration_ms`
+ */
+void wait_for(uint32_t duration_ms);
+
+/**
+ * Blocks the calling task until `condition()` returns true, checking it right
+ * away and then every `poll_ms`
+ *
+ * @return Whether the condition became true within `timeout_ms`
+ */
+template <typename Condition> bool wait_until(Condition condition, uint32_t timeout_ms, uint32_t poll_ms = WAIT_POLL_MS)
+{
+    const WaitClock& clock = wait_clock();
+    unsigned long start = clock.now_ms();
+    while (!condition()) {
+        uint32_t elapsed_ms = clock.now_ms() - start;
+        if (elapsed_ms >= timeout_ms)
+            return false;
+        uint32_t left_ms = timeout_ms - elapsed_ms;
+        clock.sleep_ms(poll_ms < left_ms ? poll_ms : left_ms);
+    }
+    return true;
+}
+
+#endif // WAIT_H
@@ -10,7 +10,12 @@
  * This function transmits current weather measurements to the Weather Underground
  * service via HTTP GET request. The data is sent in Fahrenheit units for temperature
  * and dew point, with humidity as percentage and barometric pressure in inches.
+ * The capture time of the measurement is sent as dateutc, or "now" before the
+ * first clock synchronization.
+ *
+ * @param timeout_ms Limit for the HTTP connect and response waits
+ * @return true if Weather Underground accepted the data
  */
-void send_to_wunderground(const Measurement& measurement);
+bool send_to_wunderground(const Measurement& measurement, uint32_t timeout_ms);
 
 #endif // WUNDERGROUND_H
@@ -0,0 +1,47 @@
+#ifndef NATIVE_HAL_ADAFRUIT_ADS1X15_H
+#define NATIVE_HAL_ADAFRUIT_ADS1X15_H
+
+#include <cstdint>
+
+#include "Wire.h"
+
+#define ADS1X15_ADDRESS (0x48)
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_0 (0x4000)
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_1 (0x5000)
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_2 (0x6000)
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_3 (0x7000)
+#define RATE_ADS1115_128SPS (0x0080)
+#define RATE_ADS1115_860SPS (0x00E0)
+
+typedef enum {
+    GAIN_TWOTHIRDS = 0x0000,
+    GAIN_ONE = 0x0200,
+    GAIN_TWO = 0x0400,
+    GAIN_FOUR = 0x0600,
+    GAIN_EIGHT = 0x0800,
+    GAIN_SIXTEEN = 0x0A00
+} adsGain_t;
+
+class Adafruit_ADS1115 {
+public:
+    bool begin(uint8_t i2c_addr = ADS1X15_ADDRESS, TwoWire* wire = &Wire);
+    void setGain(adsGain_t gain) { gain_ = gain; }
+    adsGain_t getGain() { return gain_; }
+    void setDataRate(uint16_t rate) { rate_ = rate; }
+    int16_t readADC_SingleEnded(uint8_t channel);
+    void startADCReading(uint16_t mux, bool continuous);
+    bool conversionComplete();
+    int16_t getLastConversionResults();
+    float computeVolts(int16_t counts);
+
+private:
+    uint32_t conversion_us() const;
+    float full_scale() const;
+
+    adsGain_t gain_ = GAIN_TWOTHIRDS;
+    uint16_t rate_ = RATE_ADS1115_128SPS;
+    uint16_t mux_ = 0;
+    uint64_t ready_at_us_ = 0;
+};
+
+#endif // NATIVE_HAL_ADAFRUIT_ADS1X15_H
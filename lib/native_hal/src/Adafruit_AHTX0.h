@@ -0,0 +1,17 @@
+#ifndef NATIVE_HAL_ADAFRUIT_AHTX0_H
+#define NATIVE_HAL_ADAFRUIT_AHTX0_H
+
+#include <cstdint>
+
+#include "Adafruit_Sensor.h"
+#include "Wire.h"
+
+#define AHTX0_I2CADDR_DEFAULT 0x38
+
+class Adafruit_AHTX0 {
+public:
+    bool begin(TwoWire* wire = &Wire, int32_t sensor_id = 0, uint8_t i2c_address = AHTX0_I2CADDR_DEFAULT);
+    bool getEvent(sensors_event_t* humidity, sensors_event_t* temp);
+};
+
+#endif // NATIVE_HAL_ADAFRUIT_AHTX0_H
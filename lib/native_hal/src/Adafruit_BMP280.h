@@ -0,0 +1,33 @@
+#ifndef NATIVE_HAL_ADAFRUIT_BMP280_H
+#define NATIVE_HAL_ADAFRUIT_BMP280_H
+
+#include <cstdint>
+
+#include "Wire.h"
+
+#define BMP280_ADDRESS (0x77)
+#define BMP280_ADDRESS_ALT (0x76)
+#define BMP280_CHIPID (0x58)
+
+class Adafruit_BMP280 {
+public:
+    enum sensor_mode { MODE_SLEEP = 0x00, MODE_FORCED = 0x01, MODE_NORMAL = 0x03 };
+    enum sensor_sampling { SAMPLING_NONE, SAMPLING_X1, SAMPLING_X2, SAMPLING_X4, SAMPLING_X8, SAMPLING_X16 };
+    enum sensor_filter { FILTER_OFF, FILTER_X2, FILTER_X4, FILTER_X8, FILTER_X16 };
+    enum standby_duration { STANDBY_MS_1, STANDBY_MS_63, STANDBY_MS_125, STANDBY_MS_250, STANDBY_MS_500, STANDBY_MS_1000 };
+
+    Adafruit_BMP280(TwoWire* wire = &Wire) { }
+    bool begin(uint8_t addr = BMP280_ADDRESS, uint8_t chipid = BMP280_CHIPID);
+    void setSampling(sensor_mode mode = MODE_NORMAL, sensor_sampling temp_sampling = SAMPLING_X16,
+        sensor_sampling press_sampling = SAMPLING_X16, sensor_filter filter = FILTER_OFF,
+        standby_duration duration = STANDBY_MS_1);
+    bool takeForcedMeasurement();
+    float readTemperature();
+    float readPressure();
+
+private:
+    sensor_mode mode_ = MODE_NORMAL;
+    uint64_t ready_at_us_ = 0; // of the conversion in progress
+};
+
+#endif // NATIVE_HAL_ADAFRUIT_BMP280_H
@@ -0,0 +1,20 @@
+#ifndef NATIVE_HAL_ADAFRUIT_SENSOR_H
+#define NATIVE_HAL_ADAFRUIT_SENSOR_H
+
+#include <cstdint>
+
+typedef struct {
+    int32_t version;
+    int32_t sensor_id;
+    int32_t type;
+    int32_t reserved0;
+    int32_t timestamp;
+    union {
+        float temperature;
+        float relative_humidity;
+        float pressure;
+        float light;
+    };
+} sensors_event_t;
+
+#endif // NATIVE_HAL_ADAFRUIT_SENSOR_H
@@ -0,0 +1,82 @@
+#ifndef NATIVE_HAL_ARDUINO_H
+#define NATIVE_HAL_ARDUINO_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "WString.h"
+#include "esp_sleep.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "sim.h"
+
+using std::max;
+using std::min;
+
+// RTC memory is a linker section of its own; sim::run_wake() carries it across simulated deep sleep.
+#define RTC_DATA_ATTR __attribute__((section("rtc_data")))
+#define RTC_NOINIT_ATTR RTC_DATA_ATTR
+#define IRAM_ATTR
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+enum adc_attenuation_t { ADC_0db, ADC_2_5db, ADC_6db, ADC_11db };
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+void analogReadResolution(uint8_t bits);
+void analogSetAttenuation(adc_attenuation_t attenuation);
+bool btStop();
+uint32_t getCpuFrequencyMhz();
+uint32_t esp_random(); // a different sequence in every wake and with every sim::Config::seed
+
+/**
+ * SNTP, as in esp32-hal-time. Until synchronized, time() counts seconds since
+ * power-on; the offset survives deep sleep like it does on the chip.
+ */
+void configTime(long gmt_offset_sec, int daylight_offset_sec, const char* server1, const char* server2 = nullptr,
+    const char* server3 = nullptr);
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+
+class HardwareSerial {
+public:
+    size_t setTxBufferSize(size_t size); // before begin()
+    void begin(unsigned long baud);
+    void end();
+    size_t print(const char* s);
+    size_t print(const String& s);
+    size_t println(const char* s = "");
+    size_t println(const String& s);
+    size_t write(const uint8_t* buffer, size_t size);
+    int availableForWrite();
+    void flush();
+    operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    [[noreturn]] void restart();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getHeapSize();
+};
+extern EspClass ESP;
+
+#endif // NATIVE_HAL_ARDUINO_H
@@ -0,0 +1,32 @@
+#ifndef NATIVE_HAL_BH1750_H
+#define NATIVE_HAL_BH1750_H
+
+#include <cstdint>
+
+#include "Wire.h"
+
+class BH1750 {
+public:
+    enum Mode {
+        UNCONFIGURED = 0,
+        CONTINUOUS_HIGH_RES_MODE = 0x10,
+        CONTINUOUS_HIGH_RES_MODE_2 = 0x11,
+        CONTINUOUS_LOW_RES_MODE = 0x13,
+        ONE_TIME_HIGH_RES_MODE = 0x20,
+        ONE_TIME_HIGH_RES_MODE_2 = 0x21,
+        ONE_TIME_LOW_RES_MODE = 0x23
+    };
+
+    BH1750(uint8_t addr = 0x23) { }
+    bool begin(Mode mode = CONTINUOUS_HIGH_RES_MODE, uint8_t addr = 0x23, TwoWire* i2c = nullptr);
+    bool configure(Mode mode);
+    bool measurementReady(bool max_wait = false);
+    float readLightLevel();
+
+private:
+    Mode mode_ = UNCONFIGURED;
+    uint32_t conversion_us_ = 0; // maximum for the mode
+    uint64_t ready_at_us_ = 0;
+};
+
+#endif // NATIVE_HAL_BH1750_H
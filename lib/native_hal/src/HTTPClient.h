@@ -0,0 +1,53 @@
+#ifndef NATIVE_HAL_HTTPCLIENT_H
+#define NATIVE_HAL_HTTPCLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "WString.h"
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+/**
+ * HTTP/1.1 client. A request costs one connect (unless the previous connection
+ * is reused) plus one server round trip; request line, headers and body are
+ * counted as bytes sent.
+ */
+class HTTPClient {
+public:
+    HTTPClient() = default;
+    ~HTTPClient();
+
+    bool begin(const String& url);
+    bool begin(WiFiClient& client, const String& url);
+    void end();
+    void addHeader(const String& name, const String& value);
+    void setTimeout(uint16_t timeout_ms);
+    void setConnectTimeout(int32_t timeout_ms);
+    void setReuse(bool reuse);
+    bool connected();
+    int GET();
+    int POST(const String& payload);
+    int POST(uint8_t* payload, size_t size);
+    int sendRequest(const char* type, uint8_t* payload, size_t size);
+    String getString();
+    static String errorToString(int error);
+
+private:
+    String url_;
+    size_t header_bytes_ = 0;
+    bool gzip_body_ = false;
+    uint16_t timeout_ms_ = 5000;
+    bool reuse_ = false;
+    bool connected_ = false;
+    uint32_t association_ = 0; // WiFi association the connection was made on
+    WiFiClient* client_ = nullptr;
+};
+
+#endif // NATIVE_HAL_HTTPCLIENT_H
@@ -0,0 +1,23 @@
+#ifndef NATIVE_HAL_IPADDRESS_H
+#define NATIVE_HAL_IPADDRESS_H
+
+#include <cstdint>
+
+#include "WString.h"
+
+class IPAddress {
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+    IPAddress(uint32_t address) : address_(address) { }
+    operator uint32_t() const { return address_; }
+    uint8_t operator[](int index) const { return (address_ >> (8 * index)) & 0xff; }
+    String toString() const;
+
+private:
+    uint32_t address_ = 0;
+};
+
+#define INADDR_NONE IPAddress((uint32_t)0)
+
+#endif // NATIVE_HAL_IPADDRESS_H
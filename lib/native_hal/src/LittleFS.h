@@ -0,0 +1,56 @@
+#ifndef NATIVE_HAL_LITTLEFS_H
+#define NATIVE_HAL_LITTLEFS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * LittleFS on the data partition, backed by files in sim::Config::flash_dir, so
+ * they persist across simulated wake cycles and power-ons. Without a flash_dir,
+ * mounting fails as on a board without a data partition.
+ */
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+public:
+    File() = default;
+    explicit File(FILE* stream)
+        : stream_(stream)
+    {
+    }
+
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t read(uint8_t* buffer, size_t size);
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t size() const;
+    void flush();
+    void close();
+    operator bool() const { return stream_ != nullptr; }
+
+private:
+    FILE* stream_ = nullptr;
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool format_on_fail = false, const char* base_path = "/littlefs", uint8_t max_open_files = 10,
+        const char* partition_label = "spiffs");
+    void end();
+    File open(const char* path, const char* mode = "r", bool create = false);
+    bool exists(const char* path);
+    bool remove(const char* path);
+
+private:
+    bool mounted_ = false;
+};
+
+} // namespace fs
+
+using fs::File;
+
+extern fs::LittleFSFS LittleFS;
+
+#endif // NATIVE_HAL_LITTLEFS_H
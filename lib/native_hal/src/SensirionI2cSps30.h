@@ -0,0 +1,32 @@
+#ifndef NATIVE_HAL_SENSIRION_I2C_SPS30_H
+#define NATIVE_HAL_SENSIRION_I2C_SPS30_H
+
+#include <cstdint>
+
+#include "Wire.h"
+
+#define SPS30_I2C_ADDR_69 0x69
+
+typedef enum {
+    SPS30_OUTPUT_FORMAT_OUTPUT_FORMAT_FLOAT = 784,
+    SPS30_OUTPUT_FORMAT_OUTPUT_FORMAT_UINT16 = 1280,
+} SPS30OutputFormat;
+
+class SensirionI2cSps30 {
+public:
+    void begin(TwoWire& i2c_bus, uint8_t i2c_address);
+    int16_t wakeUpSequence();
+    int16_t startMeasurement(SPS30OutputFormat measurement_output_format);
+    int16_t stopMeasurement();
+    int16_t readDataReadyFlag(uint16_t& data_ready_flag);
+    int16_t readMeasurementValuesFloat(float& mc1p0, float& mc2p5, float& mc4p0, float& mc10p0, float& nc0p5, float& nc1p0,
+        float& nc2p5, float& nc4p0, float& nc10p0, float& typical_particle_size);
+    int16_t startFanCleaning();
+    int16_t sleep();
+
+private:
+    bool measuring_ = false;
+    uint64_t next_sample_us_ = 0;
+};
+
+#endif // NATIVE_HAL_SENSIRION_I2C_SPS30_H
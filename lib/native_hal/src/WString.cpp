@@ -0,0 +1,174 @@
+#include "WString.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+String from_format(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+String from_format(const char* format, ...)
+{
+    char buffer[48];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return String(buffer);
+}
+
+const char* integer_format(unsigned char base, bool is_signed)
+{
+    if (base == 16)
+        return "%lx";
+    return is_signed ? "%ld" : "%lu";
+}
+
+} // namespace
+
+String::String(const char* cstr) { assign(cstr ? cstr : "", cstr ? strlen(cstr) : 0); }
+String::String(const String& other) { assign(other.c_str(), other.len_); }
+
+String::String(String&& other) noexcept
+    : buffer_(other.buffer_)
+    , capacity_(other.capacity_)
+    , len_(other.len_)
+{
+    other.buffer_ = nullptr;
+    other.capacity_ = 0;
+    other.len_ = 0;
+}
+
+String::String(char c)
+{
+    char buffer[2] = { c, 0 };
+    assign(buffer, 1);
+}
+
+String::String(int value, unsigned char base) : String((long)value, base) { }
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) { }
+String::String(long value, unsigned char base) : String(from_format(integer_format(base, true), value)) { }
+String::String(unsigned long value, unsigned char base) : String(from_format(integer_format(base, false), value)) { }
+String::String(float value, unsigned int decimal_places) : String((double)value, decimal_places) { }
+String::String(double value, unsigned int decimal_places) : String(from_format("%.*f", (int)decimal_places, value)) { }
+String::~String() { delete[] buffer_; }
+
+String& String::operator=(const String& other)
+{
+    if (this != &other)
+        assign(other.c_str(), other.len_);
+    return *this;
+}
+
+String& String::operator=(String&& other) noexcept
+{
+    if (this != &other) {
+        delete[] buffer_;
+        buffer_ = other.buffer_;
+        capacity_ = other.capacity_;
+        len_ = other.len_;
+        other.buffer_ = nullptr;
+        other.capacity_ = 0;
+        other.len_ = 0;
+    }
+    return *this;
+}
+
+String& String::operator=(const char* cstr)
+{
+    assign(cstr, strlen(cstr));
+    return *this;
+}
+
+String& String::operator+=(const String& other)
+{
+    concat(other.c_str(), other.len_);
+    return *this;
+}
+
+String& String::operator+=(const char* cstr)
+{
+    concat(cstr, strlen(cstr));
+    return *this;
+}
+
+String& String::operator+=(char c)
+{
+    concat(&c, 1);
+    return *this;
+}
+
+bool String::reserve(size_t size)
+{
+    if (size <= capacity_ && buffer_)
+        return true;
+    char* grown = new char[size + 1];
+    memcpy(grown, c_str(), len_ + 1);
+    delete[] buffer_;
+    buffer_ = grown;
+    capacity_ = size;
+    return true;
+}
+
+bool String::concat(const char* cstr, size_t length)
+{
+    reserve(len_ + length);
+    memcpy(buffer_ + len_, cstr, length);
+    len_ += length;
+    buffer_[len_] = 0;
+    return true;
+}
+
+bool String::endsWith(const String& suffix) const
+{
+    return suffix.len_ <= len_ && memcmp(c_str() + len_ - suffix.len_, suffix.c_str(), suffix.len_) == 0;
+}
+
+void String::remove(size_t index) { remove(index, (size_t)-1); }
+
+void String::remove(size_t index, size_t count)
+{
+    if (index >= len_)
+        return;
+    count = count > len_ - index ? len_ - index : count;
+    memmove(buffer_ + index, buffer_ + index + count, len_ - index - count + 1);
+    len_ -= count;
+}
+
+bool String::operator==(const String& other) const { return len_ == other.len_ && memcmp(c_str(), other.c_str(), len_) == 0; }
+
+void String::assign(const char* cstr, size_t length)
+{
+    // Like the Arduino implementation, an empty string owns no buffer.
+    if (length == 0 && !buffer_) {
+        len_ = 0;
+        return;
+    }
+    reserve(length);
+    memmove(buffer_, cstr, length);
+    len_ = length;
+    buffer_[len_] = 0;
+}
+
+String operator+(const String& lhs, const String& rhs)
+{
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+String operator+(const String& lhs, const char* rhs)
+{
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+String operator+(const char* lhs, const String& rhs)
+{
+    String result(lhs);
+    result += rhs;
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef NATIVE_HAL_WSTRING_H
+#define NATIVE_HAL_WSTRING_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Subset of the Arduino String class, heap-backed like the real one,
+ * so the allocation counters of the simulator see what the device would.
+ */
+class String {
+public:
+    String(const char* cstr = "");
+    String(const String& other);
+    String(String&& other) noexcept;
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimal_places = 2);
+    explicit String(double value, unsigned int decimal_places = 2);
+    ~String();
+
+    String& operator=(const String& other);
+    String& operator=(String&& other) noexcept;
+    String& operator=(const char* cstr);
+
+    String& operator+=(const String& other);
+    String& operator+=(const char* cstr);
+    String& operator+=(char c);
+
+    bool concat(const char* cstr, size_t length);
+    bool reserve(size_t size);
+    size_t length() const { return len_; }
+    const char* c_str() const { return buffer_ ? buffer_ : ""; }
+    bool endsWith(const String& suffix) const;
+    void remove(size_t index);
+    void remove(size_t index, size_t count);
+    bool operator==(const String& other) const;
+
+private:
+    void assign(const char* cstr, size_t length);
+
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t len_ = 0;
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+
+#endif // NATIVE_HAL_WSTRING_H
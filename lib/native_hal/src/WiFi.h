@@ -0,0 +1,50 @@
+#ifndef NATIVE_HAL_WIFI_H
+#define NATIVE_HAL_WIFI_H
+
+#include <cstdint>
+
+#include "IPAddress.h"
+#include "WiFiClient.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1 } wifi_mode_t;
+
+/**
+ * Station-mode WiFi. Association completes a configurable (virtual) time after
+ * begin(); a directed connect to a known BSSID/channel with a static address is
+ * modelled as faster than a scan plus DHCP.
+ */
+class WiFiClass {
+public:
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0, const uint8_t* bssid = nullptr,
+        bool connect = true);
+    bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1 = (uint32_t)0,
+        IPAddress dns2 = (uint32_t)0);
+    bool disconnect(bool wifioff = false, bool eraseap = false);
+    bool mode(wifi_mode_t mode);
+    bool setSleep(bool enabled);
+    wl_status_t status();
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t index = 0);
+    uint8_t* BSSID();
+    int32_t channel();
+    int8_t RSSI();
+
+private:
+    bool static_config_ = false;
+    IPAddress static_ip_;
+};
+extern WiFiClass WiFi;
+
+#endif // NATIVE_HAL_WIFI_H
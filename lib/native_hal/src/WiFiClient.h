@@ -0,0 +1,34 @@
+#ifndef NATIVE_HAL_WIFICLIENT_H
+#define NATIVE_HAL_WIFICLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "IPAddress.h"
+#include "WString.h"
+
+/**
+ * TCP client. Connects succeed after the configured round-trip time while WiFi is
+ * associated; everything written is counted as bytes on air and discarded.
+ */
+class WiFiClient {
+public:
+    virtual ~WiFiClient() = default;
+    virtual int connect(const char* host, uint16_t port);
+    virtual int connect(const char* host, uint16_t port, int32_t timeout_ms);
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t print(const char* s);
+    size_t print(const String& s);
+    virtual int available();
+    virtual int read(uint8_t* buffer, size_t size);
+    virtual void stop();
+    virtual uint8_t connected();
+    void setTimeout(uint32_t timeout_ms) { timeout_ms_ = timeout_ms; }
+    operator bool() { return connected(); }
+
+protected:
+    bool connected_ = false;
+    uint32_t timeout_ms_ = 1000;
+};
+
+#endif // NATIVE_HAL_WIFICLIENT_H
@@ -0,0 +1,32 @@
+#ifndef NATIVE_HAL_WIFIUDP_H
+#define NATIVE_HAL_WIFIUDP_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * UDP socket. Datagrams sent while WiFi is associated are counted as bytes on air
+ * and handed to sim::Config::udp_responder, whose answer becomes readable one
+ * round trip later.
+ */
+class WiFiUDP {
+public:
+    uint8_t begin(uint16_t port);
+    void stop();
+    int beginPacket(const char* host, uint16_t port);
+    size_t write(const uint8_t* buffer, size_t size);
+    int endPacket();
+    int parsePacket();
+    int read(uint8_t* buffer, size_t size);
+
+private:
+    uint8_t out_[1500];
+    size_t out_length_ = 0;
+    uint8_t in_[1500];
+    size_t in_length_ = 0;
+    size_t in_read_ = 0;
+    uint64_t in_ready_at_us_ = 0;
+    bool in_pending_ = false;
+};
+
+#endif // NATIVE_HAL_WIFIUDP_H
@@ -0,0 +1,17 @@
+#ifndef NATIVE_HAL_WIRE_H
+#define NATIVE_HAL_WIRE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+    bool end();
+    bool setClock(uint32_t frequency);
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(bool send_stop = true);
+};
+extern TwoWire Wire;
+
+#endif // NATIVE_HAL_WIRE_H
@@ -0,0 +1,228 @@
+#include "Arduino.h"
+#include "WiFi.h"
+#include "Wire.h"
+#include "esp_heap_caps.h"
+#include "esp_pm.h"
+#include "esp_sntp.h"
+
+#include <cstdio>
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+
+namespace {
+
+RTC_DATA_ATTR bool clock_synchronized = false;
+RTC_DATA_ATTR uint64_t sntp_ready_at_us = 0;
+// system time minus true time: the RTC's error in deep sleep and what settimeofday() changed
+RTC_DATA_ATTR int64_t clock_error_us = 0;
+
+sntp_sync_status_t sntp_status = SNTP_SYNC_STATUS_RESET;
+
+uint64_t timer_wakeup_us = 0;
+uint32_t serial_baud = 0; // 0: Serial not started, output is dropped
+size_t serial_tx_buffer_size = 0;
+// when the UART will have sent everything written so far; per task, as each task has its own clock
+thread_local uint64_t serial_drained_at_us = 0;
+
+constexpr size_t kUartFifoSize = 128;
+
+uint64_t serial_byte_us() { return serial_baud ? 10 * 1000000 / serial_baud : 0; } // ten bits per byte
+
+size_t serial_queued()
+{
+    uint64_t now = sim::now_us();
+    uint64_t byte_us = serial_byte_us();
+    return serial_drained_at_us > now && byte_us ? (serial_drained_at_us - now + byte_us - 1) / byte_us : 0;
+}
+
+/**
+ * The UART drains the hardware FIFO and the driver's buffer in the background;
+ * a write blocks until all but that much of it fits.
+ */
+void serial_transmit(const char* data, size_t size)
+{
+    if (serial_baud) {
+        uint64_t now = sim::now_us();
+        serial_drained_at_us = std::max(serial_drained_at_us, now) + size * serial_byte_us();
+        uint64_t fits_at_us = serial_drained_at_us - std::min<uint64_t>(serial_drained_at_us,
+            (kUartFifoSize + serial_tx_buffer_size) * serial_byte_us());
+        if (fits_at_us > now)
+            sim::advance_us(fits_at_us - now);
+    }
+    if (sim::config().echo_serial)
+        fwrite(data, 1, size, stdout);
+}
+
+int64_t true_time_us() { return (int64_t)sim::now_us() + (clock_synchronized ? sim::config().epoch_at_power_on * 1000000 : 0); }
+
+/**
+ * What time() and gettimeofday() report, in microseconds
+ */
+int64_t system_time_us() { return true_time_us() + clock_error_us; }
+
+/**
+ * Sets the system time to the SNTP server's once its answer is in
+ */
+void complete_sntp()
+{
+    if (sntp_ready_at_us == 0 || sntp_ready_at_us > sim::now_us())
+        return;
+    sim::count_sent(2 * 90); // NTP request and response
+    sim::count_sntp_sync();
+    clock_synchronized = true;
+    clock_error_us = 0;
+    sntp_ready_at_us = 0;
+    sntp_status = SNTP_SYNC_STATUS_COMPLETED;
+}
+
+} // namespace
+
+unsigned long millis() { return (unsigned long)(sim::uptime_us() / 1000); }
+unsigned long micros() { return (unsigned long)sim::uptime_us(); }
+void delay(uint32_t ms) { sim::wait_us((uint64_t)ms * 1000); }
+void delayMicroseconds(uint32_t us) { sim::advance_us(us); }
+void yield() { }
+
+void pinMode(uint8_t, uint8_t) { }
+void digitalWrite(uint8_t, uint8_t) { }
+void analogReadResolution(uint8_t) { }
+void analogSetAttenuation(adc_attenuation_t) { }
+bool btStop() { return true; }
+
+uint32_t esp_random()
+{
+    // splitmix64
+    static uint64_t state = sim::now_us() ^ ((uint64_t)sim::config().seed << 32);
+    uint64_t x = (state += 0x9E3779B97F4A7C15ull);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return (uint32_t)(x ^ (x >> 31));
+}
+
+void configTime(long, int, const char*, const char*, const char*)
+{
+    if (WiFi.status() == WL_CONNECTED)
+        sntp_ready_at_us = sim::now_us() + (uint64_t)sim::config().sntp_ms * 1000;
+}
+
+bool getLocalTime(struct tm* info, uint32_t ms)
+{
+    if (!clock_synchronized && sntp_ready_at_us != 0) {
+        uint64_t deadline = sim::now_us() + (uint64_t)ms * 1000;
+        sim::advance_us(std::min(std::max(sntp_ready_at_us, sim::now_us()), deadline) - sim::now_us());
+        complete_sntp();
+    }
+    time_t now = time(nullptr);
+    gmtime_r(&now, info);
+    return clock_synchronized;
+}
+
+sntp_sync_status_t sntp_get_sync_status()
+{
+    complete_sntp();
+    sntp_sync_status_t status = sntp_status;
+    if (status == SNTP_SYNC_STATUS_COMPLETED)
+        sntp_status = SNTP_SYNC_STATUS_RESET; // read once, as in ESP-IDF
+    return status;
+}
+
+void sntp_set_sync_status(sntp_sync_status_t status) { sntp_status = status; }
+void esp_sntp_stop() { sntp_ready_at_us = 0; }
+
+/**
+ * Replace the C library's clock for the whole simulation binary
+ */
+extern "C" time_t time(time_t* result)
+{
+    int64_t now_us = system_time_us();
+    time_t now = (time_t)(now_us >= 0 ? now_us / 1000000 : (now_us - 999999) / 1000000);
+    if (result)
+        *result = now;
+    return now;
+}
+
+extern "C" int gettimeofday(struct timeval* tv, void*)
+{
+    int64_t now_us = system_time_us();
+    tv->tv_sec = (time_t)(now_us >= 0 ? now_us / 1000000 : (now_us - 999999) / 1000000);
+    tv->tv_usec = (suseconds_t)(now_us - (int64_t)tv->tv_sec * 1000000);
+    return 0;
+}
+
+extern "C" int settimeofday(const struct timeval* tv, const struct timezone*)
+{
+    clock_error_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - true_time_us();
+    return 0;
+}
+
+size_t HardwareSerial::setTxBufferSize(size_t size)
+{
+    serial_tx_buffer_size = size;
+    return size;
+}
+
+void HardwareSerial::begin(unsigned long baud) { serial_baud = baud; }
+void HardwareSerial::end() { serial_baud = 0; }
+size_t HardwareSerial::print(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+size_t HardwareSerial::print(const String& s) { return print(s.c_str()); }
+size_t HardwareSerial::println(const char* s) { return print(s) + print("\r\n"); }
+size_t HardwareSerial::println(const String& s) { return println(s.c_str()); }
+int HardwareSerial::availableForWrite() { return (int)(kUartFifoSize + serial_tx_buffer_size - serial_queued()); }
+void HardwareSerial::flush() { }
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    serial_transmit(reinterpret_cast<const char*>(buffer), size);
+    return size;
+}
+
+void EspClass::restart() { throw sim::Restart(); }
+uint32_t EspClass::getFreeHeap() { return sim::heap_free(); }
+uint32_t EspClass::getMinFreeHeap() { return sim::heap_min_free(); }
+uint32_t EspClass::getMaxAllocHeap() { return sim::heap_free(); }
+uint32_t EspClass::getHeapSize() { return 320 * 1024; }
+
+size_t heap_caps_get_free_size(uint32_t) { return sim::heap_free(); }
+size_t heap_caps_get_largest_free_block(uint32_t) { return sim::heap_free(); }
+size_t heap_caps_get_minimum_free_size(uint32_t) { return sim::heap_min_free(); }
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    timer_wakeup_us = time_in_us;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start()
+{
+    sim::record_clock(clock_synchronized, clock_error_us);
+    // the RTC slow clock counts the sleep with its own error
+    clock_error_us += (int64_t)timer_wakeup_us * sim::config().rtc_drift_ppm / 1000000;
+    throw sim::DeepSleep { timer_wakeup_us };
+}
+
+esp_err_t esp_light_sleep_start()
+{
+    sim::wait_us(timer_wakeup_us);
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() { return (int64_t)sim::uptime_us(); }
+
+esp_err_t esp_pm_configure(const void* config)
+{
+    const esp_pm_config_t* pm = static_cast<const esp_pm_config_t*>(config);
+    if (!sim::config().power_management || (pm->light_sleep_enable && !sim::config().light_sleep))
+        return ESP_ERR_NOT_SUPPORTED;
+    sim::set_power_management(pm->min_freq_mhz < pm->max_freq_mhz, pm->light_sleep_enable);
+    return ESP_OK;
+}
+
+uint32_t getCpuFrequencyMhz() { return 240; }
+
+bool TwoWire::begin(int, int, uint32_t) { return true; }
+bool TwoWire::end() { return true; }
+bool TwoWire::setClock(uint32_t) { return true; }
+void TwoWire::beginTransmission(uint8_t) { sim::count_i2c_transaction(); }
+uint8_t TwoWire::endTransmission(bool) { return 0; }
@@ -0,0 +1,8 @@
+#ifndef NATIVE_HAL_DRIVER_RTC_IO_H
+#define NATIVE_HAL_DRIVER_RTC_IO_H
+
+typedef int gpio_num_t;
+
+inline int rtc_gpio_isolate(gpio_num_t) { return 0; }
+
+#endif // NATIVE_HAL_DRIVER_RTC_IO_H
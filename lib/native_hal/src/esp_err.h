@@ -0,0 +1,8 @@
+#ifndef NATIVE_HAL_ESP_ERR_H
+#define NATIVE_HAL_ESP_ERR_H
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERR_NOT_SUPPORTED 0x106
+
+#endif // NATIVE_HAL_ESP_ERR_H
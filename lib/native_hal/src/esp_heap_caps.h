@@ -0,0 +1,30 @@
+#ifndef NATIVE_HAL_ESP_HEAP_CAPS_H
+#define NATIVE_HAL_ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sdkconfig.h"
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+extern "C" {
+
+/**
+ * The simulated heap is one region without fragmentation: the largest free block
+ * is all that is free
+ */
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps); // lowest since the wake started
+
+/**
+ * Called by operator new after each allocation, if the firmware defines it, as
+ * ESP-IDF does with CONFIG_HEAP_USE_HOOKS
+ */
+void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) __attribute__((weak));
+void esp_heap_trace_free_hook(void* ptr) __attribute__((weak));
+
+} // extern "C"
+
+#endif // NATIVE_HAL_ESP_HEAP_CAPS_H
@@ -0,0 +1,8 @@
+#ifndef NATIVE_HAL_ESP_IDF_VERSION_H
+#define NATIVE_HAL_ESP_IDF_VERSION_H
+
+#define ESP_IDF_VERSION_MAJOR 5
+#define ESP_IDF_VERSION_MINOR 1
+#define ESP_IDF_VERSION_PATCH 0
+
+#endif // NATIVE_HAL_ESP_IDF_VERSION_H
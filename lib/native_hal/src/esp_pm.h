@@ -0,0 +1,21 @@
+#ifndef NATIVE_HAL_ESP_PM_H
+#define NATIVE_HAL_ESP_PM_H
+
+#include "esp_err.h"
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+/**
+ * Power management as in ESP-IDF 5: once configured, the time in which every task
+ * is blocked is spent at min_freq_mhz, or in light sleep with the radio off
+ * (see sim::WakeStats). Not supported with sim::Config::power_management off;
+ * light sleep not with sim::Config::light_sleep off, as with an SDK built without
+ * tickless idle.
+ */
+esp_err_t esp_pm_configure(const void* config);
+
+#endif // NATIVE_HAL_ESP_PM_H
@@ -0,0 +1,13 @@
+#ifndef NATIVE_HAL_ESP_SLEEP_H
+#define NATIVE_HAL_ESP_SLEEP_H
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+[[noreturn]] void esp_deep_sleep_start();
+esp_err_t esp_light_sleep_start();
+int64_t esp_timer_get_time();
+
+#endif // NATIVE_HAL_ESP_SLEEP_H
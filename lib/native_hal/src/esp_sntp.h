@@ -0,0 +1,20 @@
+#ifndef NATIVE_HAL_ESP_SNTP_H
+#define NATIVE_HAL_ESP_SNTP_H
+
+#include <sys/time.h>
+
+typedef enum {
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+/**
+ * SNTP as in ESP-IDF 5, started by configTime(): the system time is set
+ * sim::Config::sntp_ms after the request, and the status turns to COMPLETED
+ */
+sntp_sync_status_t sntp_get_sync_status();
+void sntp_set_sync_status(sntp_sync_status_t status);
+void esp_sntp_stop();
+
+#endif // NATIVE_HAL_ESP_SNTP_H
@@ -0,0 +1,89 @@
+#include "LittleFS.h"
+#include "sim.h"
+
+#include <string>
+#include <unistd.h>
+
+fs::LittleFSFS LittleFS;
+
+namespace {
+
+std::string host_path(const char* path) { return std::string(sim::config().flash_dir) + path; }
+
+} // namespace
+
+namespace fs {
+
+size_t File::write(const uint8_t* buffer, size_t size)
+{
+    if (!stream_)
+        return 0;
+    sim::advance_us(sim::config().flash_write_us);
+    return fwrite(buffer, 1, size, stream_);
+}
+
+size_t File::read(uint8_t* buffer, size_t size)
+{
+    if (!stream_)
+        return 0;
+    sim::advance_us(sim::config().flash_read_us);
+    return fread(buffer, 1, size, stream_);
+}
+
+bool File::seek(uint32_t position, SeekMode mode)
+{
+    static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+    return stream_ && fseek(stream_, position, whence[mode]) == 0;
+}
+
+size_t File::size() const
+{
+    if (!stream_)
+        return 0;
+    long position = ftell(stream_);
+    fseek(stream_, 0, SEEK_END);
+    long end = ftell(stream_);
+    fseek(stream_, position, SEEK_SET);
+    return (size_t)end;
+}
+
+void File::flush()
+{
+    if (stream_)
+        fflush(stream_);
+}
+
+void File::close()
+{
+    if (stream_)
+        fclose(stream_);
+    stream_ = nullptr;
+}
+
+bool LittleFSFS::begin(bool, const char*, uint8_t, const char*)
+{
+    if (!sim::config().flash_dir)
+        return false;
+    sim::advance_ms(sim::config().flash_mount_ms);
+    mounted_ = true;
+    return true;
+}
+
+void LittleFSFS::end() { mounted_ = false; }
+
+File LittleFSFS::open(const char* path, const char* mode, bool create)
+{
+    if (!mounted_)
+        return File();
+    std::string file = host_path(path);
+    // "w"/"a" create, "r"/"r+" only with `create`, as in the ESP32 core
+    if (create && mode[0] == 'r' && access(file.c_str(), F_OK) != 0)
+        fclose(fopen(file.c_str(), "w"));
+    sim::advance_us(sim::config().flash_read_us);
+    return File(fopen(file.c_str(), mode));
+}
+
+bool LittleFSFS::exists(const char* path) { return mounted_ && access(host_path(path).c_str(), F_OK) == 0; }
+bool LittleFSFS::remove(const char* path) { return mounted_ && ::remove(host_path(path).c_str()) == 0; }
+
+} // namespace fs
@@ -0,0 +1,20 @@
+#ifndef NATIVE_HAL_FREERTOS_SEMPHR_H
+#define NATIVE_HAL_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+/**
+ * Binary semaphores and mutexes. A give stamps the giver's virtual time, and the
+ * taker's clock moves forward to that stamp, which is how joins account for the
+ * time the other task spent.
+ */
+struct sim_semaphore;
+typedef sim_semaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif // NATIVE_HAL_FREERTOS_SEMPHR_H
@@ -0,0 +1,21 @@
+#ifndef NATIVE_HAL_FREERTOS_TASK_H
+#define NATIVE_HAL_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+/**
+ * Tasks are backed by host threads. Each thread carries its own virtual clock,
+ * forked from its creator, so work done in parallel on the device also overlaps
+ * in simulated time (see sim.h).
+ */
+struct sim_task;
+typedef sim_task* TaskHandle_t;
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stack_depth, void* parameters, UBaseType_t priority,
+    TaskHandle_t* created_task);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+#endif // NATIVE_HAL_FREERTOS_TASK_H
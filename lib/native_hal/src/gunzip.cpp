@@ -0,0 +1,127 @@
+#include "sim.h"
+
+#include <cstring>
+
+namespace {
+
+/**
+ * Bit reader for the deflate stream, least significant bit first
+ */
+struct BitReader {
+    const uint8_t* data;
+    size_t length;
+    size_t position = 0;
+    uint32_t bits = 0;
+    uint8_t bit_count = 0;
+    bool overrun = false;
+
+    uint32_t get(uint8_t count)
+    {
+        while (bit_count < count) {
+            if (position >= length) {
+                overrun = true;
+                return 0;
+            }
+            bits |= (uint32_t)data[position++] << bit_count;
+            bit_count += 8;
+        }
+        uint32_t value = bits & ((1u << count) - 1);
+        bits >>= count;
+        bit_count -= count;
+        return value;
+    }
+
+    // Huffman codes arrive most significant bit first
+    uint32_t get_code(uint8_t count)
+    {
+        uint32_t code = 0;
+        for (uint8_t i = 0; i < count; i++)
+            code = (code << 1) | get(1);
+        return code;
+    }
+};
+
+const uint16_t length_base[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163,
+    195, 227, 258 };
+const uint8_t length_extra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t distance_base[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049,
+    3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t distance_extra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/**
+ * Decodes one symbol of the fixed literal/length code (RFC 1951, 3.2.6)
+ */
+int fixed_symbol(BitReader& reader)
+{
+    uint32_t code = reader.get_code(7);
+    if (code <= 0x17)
+        return 256 + code;
+    code = (code << 1) | reader.get(1);
+    if (code >= 0x30 && code <= 0xbf)
+        return code - 0x30;
+    if (code >= 0xc0 && code <= 0xc7)
+        return 280 + code - 0xc0;
+    code = (code << 1) | reader.get(1);
+    return 144 + code - 0x190;
+}
+
+} // namespace
+
+namespace sim {
+
+bool gunzip(const uint8_t* data, size_t length, std::vector<uint8_t>& out)
+{
+    out.clear();
+    if (length < 18 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || data[3] != 0)
+        return false;
+
+    BitReader reader { data + 10, length - 18 };
+    bool final_block = false;
+    while (!final_block) {
+        final_block = reader.get(1);
+        uint32_t type = reader.get(2);
+        if (type == 0) {
+            reader.bits = 0;
+            reader.bit_count = 0;
+            if (reader.position + 4 > reader.length)
+                return false;
+            uint16_t stored = reader.data[reader.position] | (reader.data[reader.position + 1] << 8);
+            reader.position += 4;
+            if (reader.position + stored > reader.length)
+                return false;
+            out.insert(out.end(), reader.data + reader.position, reader.data + reader.position + stored);
+            reader.position += stored;
+            continue;
+        }
+        if (type != 1)
+            return false; // dynamic codes are not produced by the firmware's encoder
+
+        for (;;) {
+            int symbol = fixed_symbol(reader);
+            if (reader.overrun || symbol > 285)
+                return false;
+            if (symbol < 256) {
+                out.push_back((uint8_t)symbol);
+                continue;
+            }
+            if (symbol == 256)
+                break;
+            int index = symbol - 257;
+            size_t match_length = length_base[index] + reader.get(length_extra[index]);
+            uint32_t distance_code = reader.get_code(5);
+            if (distance_code >= 30)
+                return false;
+            size_t distance = distance_base[distance_code] + reader.get(distance_extra[distance_code]);
+            if (distance > out.size())
+                return false;
+            for (size_t i = 0; i < match_length; i++)
+                out.push_back(out[out.size() - distance]);
+        }
+    }
+
+    const uint8_t* trailer = data + length - 4;
+    uint32_t size = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+    return !reader.overrun && size == (uint32_t)out.size();
+}
+
+} // namespace sim
@@ -0,0 +1,268 @@
+#include "HTTPClient.h"
+#include "WiFiUdp.h"
+#include "WiFi.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+WiFiClass WiFi;
+
+namespace {
+
+const uint8_t station_bssid[6] = { 0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56 };
+const int32_t station_channel = 6;
+
+bool begun = false;
+bool gave_up = false;
+uint64_t connected_at_us = 0;
+uint32_t association = 0; // counts WiFi.begin() calls; connections do not survive a new association
+
+bool associated() { return begun && !gave_up && sim::now_us() >= connected_at_us; }
+
+} // namespace
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : address_((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24))
+{
+}
+
+String IPAddress::toString() const
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buffer);
+}
+
+wl_status_t WiFiClass::begin(const char*, const char*, int32_t channel, const uint8_t* bssid, bool)
+{
+    const sim::Config& config = sim::config();
+    sim::radio_on();
+    begun = true;
+    association++;
+    uint64_t now_s = sim::now_us() / 1000000;
+    gave_up = !config.wifi_available || (now_s >= config.outage_start_s && now_s < config.outage_end_s);
+
+    bool directed = bssid && channel == station_channel && memcmp(bssid, station_bssid, sizeof(station_bssid)) == 0;
+    uint64_t connect_ms = config.wifi_association_ms;
+    if (!directed)
+        connect_ms += config.wifi_scan_ms;
+    if (!static_config_)
+        connect_ms += config.dhcp_ms;
+    connected_at_us = sim::now_us() + connect_ms * 1000;
+    return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress local_ip, IPAddress, IPAddress, IPAddress, IPAddress)
+{
+    static_config_ = (uint32_t)local_ip != 0;
+    static_ip_ = local_ip;
+    return true;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool)
+{
+    begun = false;
+    if (wifioff)
+        sim::radio_off();
+    return true;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode)
+{
+    if (mode == WIFI_OFF) {
+        begun = false;
+        sim::radio_off();
+    }
+    return true;
+}
+
+bool WiFiClass::setSleep(bool) { return true; }
+
+wl_status_t WiFiClass::status()
+{
+    if (!begun)
+        return WL_IDLE_STATUS;
+    if (gave_up)
+        return sim::now_us() >= connected_at_us ? WL_NO_SSID_AVAIL : WL_DISCONNECTED;
+    return associated() ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP() { return static_config_ ? static_ip_ : IPAddress(192, 168, 1, 50); }
+IPAddress WiFiClass::gatewayIP() { return IPAddress(192, 168, 1, 1); }
+IPAddress WiFiClass::subnetMask() { return IPAddress(255, 255, 255, 0); }
+IPAddress WiFiClass::dnsIP(uint8_t) { return IPAddress(192, 168, 1, 1); }
+uint8_t* WiFiClass::BSSID() { return const_cast<uint8_t*>(station_bssid); }
+int32_t WiFiClass::channel() { return station_channel; }
+int8_t WiFiClass::RSSI() { return -67; }
+
+int WiFiClient::connect(const char* host, uint16_t port) { return connect(host, port, timeout_ms_); }
+
+int WiFiClient::connect(const char*, uint16_t, int32_t timeout_ms)
+{
+    if (!associated()) {
+        sim::advance_ms(timeout_ms);
+        return 0;
+    }
+    sim::advance_ms(sim::config().tcp_connect_ms);
+    sim::count_connection(false);
+    connected_ = true;
+    return 1;
+}
+
+size_t WiFiClient::write(const uint8_t*, size_t size)
+{
+    if (!connected_)
+        return 0;
+    sim::count_sent(size);
+    return size;
+}
+
+size_t WiFiClient::print(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+size_t WiFiClient::print(const String& s) { return write(reinterpret_cast<const uint8_t*>(s.c_str()), s.length()); }
+int WiFiClient::available() { return 0; }
+int WiFiClient::read(uint8_t*, size_t) { return -1; }
+void WiFiClient::stop() { connected_ = false; }
+uint8_t WiFiClient::connected() { return connected_; }
+
+HTTPClient::~HTTPClient() { end(); }
+
+bool HTTPClient::begin(const String& url)
+{
+    url_ = url;
+    header_bytes_ = 0;
+    gzip_body_ = false;
+    return true;
+}
+
+bool HTTPClient::begin(WiFiClient& client, const String& url)
+{
+    client_ = &client;
+    return begin(url);
+}
+
+void HTTPClient::end()
+{
+    if (!reuse_)
+        connected_ = false;
+}
+
+void HTTPClient::addHeader(const String& name, const String& value)
+{
+    header_bytes_ += name.length() + value.length() + 4;
+    if (name == "Content-Encoding" && value == "gzip")
+        gzip_body_ = true;
+}
+void HTTPClient::setTimeout(uint16_t timeout_ms) { timeout_ms_ = timeout_ms; }
+void HTTPClient::setConnectTimeout(int32_t) { }
+void HTTPClient::setReuse(bool reuse) { reuse_ = reuse; }
+bool HTTPClient::connected() { return connected_ && association_ == association && associated(); }
+int HTTPClient::GET() { return sendRequest("GET", nullptr, 0); }
+int HTTPClient::POST(const String& payload) { return sendRequest("POST", (uint8_t*)payload.c_str(), payload.length()); }
+int HTTPClient::POST(uint8_t* payload, size_t size) { return sendRequest("POST", payload, size); }
+
+int HTTPClient::sendRequest(const char* type, uint8_t* payload, size_t size)
+{
+    const sim::Config& config = sim::config();
+    if (!associated())
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    if (!connected()) {
+        bool tls = strncmp(url_.c_str(), "https://", 8) == 0;
+        sim::advance_ms(config.tcp_connect_ms);
+        if (tls)
+            sim::advance_ms(config.tls_handshake_ms);
+        sim::count_connection(tls);
+        connected_ = true;
+        association_ = association;
+    }
+    // request line, Host/User-Agent/Connection/Content-Length boilerplate, caller headers, body
+    size_t request_bytes = strlen(type) + url_.length() + 120 + header_bytes_ + size;
+    sim::count_sent(request_bytes);
+    sim::count_request();
+    if (config.uplink_kbps > 0)
+        sim::advance_us((uint64_t)request_bytes * 8000 / config.uplink_kbps);
+
+    std::vector<uint8_t> body;
+    if (gzip_body_) {
+        if (!sim::gunzip(payload, size, body)) {
+            fprintf(stderr, "sim: malformed gzip body sent to %s\n", url_.c_str());
+            abort();
+        }
+        payload = body.data();
+        size = body.size();
+    }
+    uint32_t response_ms = config.http_response_ms;
+    int status = config.http_responder ? config.http_responder(url_.c_str(), request_bytes, &response_ms) : config.http_status;
+    if (response_ms > timeout_ms_) {
+        sim::advance_ms(timeout_ms_);
+        connected_ = false;
+        return HTTPC_ERROR_READ_TIMEOUT;
+    }
+    sim::advance_ms(response_ms);
+    if (status / 100 == 2 && strstr(url_.c_str(), "/api/v2/write")) {
+        uint32_t points = 0;
+        for (size_t i = 0; i + 8 <= size; i++)
+            if ((i == 0 || payload[i - 1] == '\n') && memcmp(payload + i, "weather ", 8) == 0)
+                points++;
+        sim::count_points_written(points);
+    }
+    return status;
+}
+
+String HTTPClient::getString() { return String(""); }
+
+String HTTPClient::errorToString(int error) { return String("error ") + String(error); }
+
+uint8_t WiFiUDP::begin(uint16_t) { return 1; }
+void WiFiUDP::stop() { in_pending_ = false; }
+
+int WiFiUDP::beginPacket(const char*, uint16_t)
+{
+    out_length_ = 0;
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size)
+{
+    size_t fits = std::min(size, sizeof(out_) - out_length_);
+    memcpy(out_ + out_length_, buffer, fits);
+    out_length_ += fits;
+    return fits;
+}
+
+int WiFiUDP::endPacket()
+{
+    if (!associated())
+        return 0;
+    sim::count_sent(out_length_);
+    const sim::Config& config = sim::config();
+    if (config.udp_responder) {
+        size_t length = config.udp_responder(out_, out_length_, in_, sizeof(in_));
+        if (length > 0) {
+            in_length_ = length;
+            in_read_ = 0;
+            in_ready_at_us_ = sim::now_us() + (uint64_t)config.udp_rtt_ms * 1000;
+            in_pending_ = true;
+        }
+    }
+    return 1;
+}
+
+int WiFiUDP::parsePacket()
+{
+    if (!in_pending_ || sim::now_us() < in_ready_at_us_)
+        return 0;
+    in_pending_ = false;
+    return (int)in_length_;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t size)
+{
+    size_t length = std::min(size, in_length_ - in_read_);
+    memcpy(buffer, in_ + in_read_, length);
+    in_read_ += length;
+    return (int)length;
+}
@@ -0,0 +1,9 @@
+#ifndef NATIVE_HAL_SDKCONFIG_H
+#define NATIVE_HAL_SDKCONFIG_H
+
+/**
+ * SDK options of the simulated board
+ */
+#define CONFIG_HEAP_USE_HOOKS 1 // esp_heap_trace_alloc_hook() sees every allocation (esp_heap_caps.h)
+
+#endif // NATIVE_HAL_SDKCONFIG_H
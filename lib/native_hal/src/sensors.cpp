@@ -0,0 +1,216 @@
+#include "Adafruit_ADS1X15.h"
+#include "Adafruit_AHTX0.h"
+#include "Adafruit_BMP280.h"
+#include "BH1750.h"
+#include "SensirionI2cSps30.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Cost of addressing a chip that does not answer (NACK plus the driver's retries).
+constexpr uint32_t kMissingProbeUs = 1500;
+
+bool probe(bool present, uint32_t init_us)
+{
+    sim::count_i2c_transaction();
+    sim::advance_us(present ? init_us : kMissingProbeUs);
+    return present;
+}
+
+} // namespace
+
+bool Adafruit_BMP280::begin(uint8_t addr, uint8_t)
+{
+    const sim::Config& config = sim::config();
+    mode_ = MODE_NORMAL;
+    ready_at_us_ = 0; // the driver's delay(100) outlasts the first conversion in normal mode
+    if (!probe(config.bmp280_present && addr == config.bmp280_address, 2000))
+        return false;
+    sim::wait_us(100000); // delay(100) after the reset, the CPU idles
+    return true;
+}
+
+void Adafruit_BMP280::setSampling(sensor_mode mode, sensor_sampling, sensor_sampling, sensor_filter, standby_duration)
+{
+    mode_ = mode;
+    if (mode == MODE_FORCED)
+        ready_at_us_ = sim::now_us() + 43200; // writing forced mode starts a conversion (ultra high resolution)
+}
+
+bool Adafruit_BMP280::takeForcedMeasurement()
+{
+    if (mode_ != MODE_FORCED)
+        return false;
+    ready_at_us_ = sim::now_us() + 43200;
+    sim::advance_us(44000);
+    return true;
+}
+
+// until a conversion is done, the data registers hold their reset value, which the driver reads as NAN
+float Adafruit_BMP280::readTemperature() { return sim::now_us() < ready_at_us_ ? NAN : sim::temperature_c() + 0.4f; }
+float Adafruit_BMP280::readPressure() { return sim::now_us() < ready_at_us_ ? NAN : sim::pressure_pa(); }
+
+bool Adafruit_AHTX0::begin(TwoWire*, int32_t, uint8_t)
+{
+    sim::advance_ms(20); // power-up wait, paid whether or not the chip is there
+    return probe(sim::config().aht20_present, 10000);
+}
+
+bool Adafruit_AHTX0::getEvent(sensors_event_t* humidity, sensors_event_t* temp)
+{
+    sim::advance_ms(80); // triggered conversion
+    humidity->relative_humidity = sim::humidity();
+    temp->temperature = sim::temperature_c();
+    return true;
+}
+
+bool BH1750::begin(Mode mode, uint8_t, TwoWire*)
+{
+    if (!probe(sim::config().bh1750_present, 200))
+        return false;
+    return configure(mode);
+}
+
+bool BH1750::configure(Mode mode)
+{
+    mode_ = mode;
+    conversion_us_ = (mode == CONTINUOUS_LOW_RES_MODE || mode == ONE_TIME_LOW_RES_MODE) ? 24000 : 180000;
+    ready_at_us_ = sim::now_us() + conversion_us_;
+    return true;
+}
+
+bool BH1750::measurementReady(bool max_wait)
+{
+    // the driver only looks at the time since configure(): the typical or the maximum conversion time
+    uint64_t ready_at_us = max_wait ? ready_at_us_ : ready_at_us_ - conversion_us_ / 3;
+    return sim::now_us() >= ready_at_us;
+}
+
+float BH1750::readLightLevel()
+{
+    if (mode_ == UNCONFIGURED)
+        return -2;
+    if (sim::now_us() < ready_at_us_)
+        return 0; // the data register still holds its reset value
+    return std::max(0.0f, sim::illumination_lux());
+}
+
+bool Adafruit_ADS1115::begin(uint8_t, TwoWire*) { return probe(sim::config().ads1115_present, 300); }
+
+uint32_t Adafruit_ADS1115::conversion_us() const { return rate_ == RATE_ADS1115_860SPS ? 1200 + 100 : 7800 + 100; }
+
+float Adafruit_ADS1115::full_scale() const
+{
+    switch (gain_) {
+    case GAIN_TWOTHIRDS:
+        return 6.144f;
+    case GAIN_ONE:
+        return 4.096f;
+    case GAIN_TWO:
+        return 2.048f;
+    case GAIN_FOUR:
+        return 1.024f;
+    case GAIN_EIGHT:
+        return 0.512f;
+    default:
+        return 0.256f;
+    }
+}
+
+void Adafruit_ADS1115::startADCReading(uint16_t mux, bool)
+{
+    mux_ = mux;
+    ready_at_us_ = sim::now_us() + conversion_us();
+}
+
+bool Adafruit_ADS1115::conversionComplete() { return sim::now_us() >= ready_at_us_; }
+
+int16_t Adafruit_ADS1115::getLastConversionResults()
+{
+    float volts = 0;
+    switch (mux_) {
+    case ADS1X15_REG_CONFIG_MUX_SINGLE_0:
+        volts = (sim::battery_voltage() - 0.03f) / 1.33f;
+        break;
+    case ADS1X15_REG_CONFIG_MUX_SINGLE_1:
+        volts = sim::solar_panel_voltage() / 2.43f;
+        break;
+    case ADS1X15_REG_CONFIG_MUX_SINGLE_2:
+        volts = sim::uv_voltage();
+        break;
+    }
+    float counts = volts / full_scale() * 32768.0f;
+    return (int16_t)std::max(-32768.0f, std::min(32767.0f, counts));
+}
+
+int16_t Adafruit_ADS1115::readADC_SingleEnded(uint8_t channel)
+{
+    static const uint16_t muxes[] = { ADS1X15_REG_CONFIG_MUX_SINGLE_0, ADS1X15_REG_CONFIG_MUX_SINGLE_1,
+        ADS1X15_REG_CONFIG_MUX_SINGLE_2, ADS1X15_REG_CONFIG_MUX_SINGLE_3 };
+    startADCReading(muxes[channel & 3], false);
+    sim::advance_us(conversion_us());
+    return getLastConversionResults();
+}
+
+float Adafruit_ADS1115::computeVolts(int16_t counts) { return counts * full_scale() / 32768.0f; }
+
+void SensirionI2cSps30::begin(TwoWire&, uint8_t) { }
+
+int16_t SensirionI2cSps30::wakeUpSequence()
+{
+    sim::count_i2c_transaction();
+    sim::advance_ms(5);
+    return sim::config().sps30_present ? 0 : 0x101;
+}
+
+int16_t SensirionI2cSps30::startMeasurement(SPS30OutputFormat)
+{
+    measuring_ = true;
+    next_sample_us_ = sim::now_us() + 1000000;
+    return 0;
+}
+
+int16_t SensirionI2cSps30::stopMeasurement()
+{
+    measuring_ = false;
+    return 0;
+}
+
+int16_t SensirionI2cSps30::readDataReadyFlag(uint16_t& data_ready_flag)
+{
+    sim::advance_us(500);
+    data_ready_flag = measuring_ && sim::now_us() >= next_sample_us_;
+    return 0;
+}
+
+int16_t SensirionI2cSps30::readMeasurementValuesFloat(float& mc1p0, float& mc2p5, float& mc4p0, float& mc10p0, float& nc0p5,
+    float& nc1p0, float& nc2p5, float& nc4p0, float& nc10p0, float& typical_particle_size)
+{
+    sim::advance_us(1500);
+    if (!measuring_)
+        return 0x102;
+    uint64_t now = sim::now_us();
+    next_sample_us_ = now + 1000000 - (now - next_sample_us_) % 1000000;
+    mc1p0 = sim::pm_ugm3(0);
+    mc2p5 = sim::pm_ugm3(1);
+    mc4p0 = sim::pm_ugm3(2);
+    mc10p0 = sim::pm_ugm3(3);
+    nc0p5 = mc1p0 * 6.5f;
+    nc1p0 = mc1p0 * 7.5f;
+    nc2p5 = mc2p5 * 7.6f;
+    nc4p0 = mc4p0 * 7.6f;
+    nc10p0 = mc10p0 * 7.6f;
+    typical_particle_size = 0.55f;
+    return 0;
+}
+
+int16_t SensirionI2cSps30::startFanCleaning() { return measuring_ ? 0 : 0x103; }
+
+int16_t SensirionI2cSps30::sleep()
+{
+    measuring_ = false;
+    return 0;
+}
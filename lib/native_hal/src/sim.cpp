@@ -0,0 +1,527 @@
+#include "sim.h"
+
+#include "Arduino.h"
+#include "esp_heap_caps.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kHeapSize = 320 * 1024;
+
+thread_local uint64_t t_now_us = 0;
+uint64_t station_time_us = 0;
+uint64_t wake_start_us = 0;
+
+std::atomic<bool> radio_state { false };
+uint64_t radio_on_since_us = 0;
+sim::WakeStats wake_stats;
+std::mutex stats_lock;
+
+/**
+ * Allocates with malloc(), so the simulator's own bookkeeping is not counted as
+ * allocations of the firmware
+ */
+template <typename T> struct UntrackedAllocator {
+    typedef T value_type;
+
+    UntrackedAllocator() = default;
+    template <typename U> UntrackedAllocator(const UntrackedAllocator<U>&) { }
+
+    T* allocate(size_t count)
+    {
+        T* pointer = static_cast<T*>(malloc(count * sizeof(T)));
+        if (!pointer)
+            throw std::bad_alloc();
+        return pointer;
+    }
+    void deallocate(T* pointer, size_t) { free(pointer); }
+
+    template <typename U> bool operator==(const UntrackedAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const UntrackedAllocator<U>&) const { return false; }
+};
+
+typedef std::pair<uint64_t, uint64_t> Interval; // [first, second)
+typedef std::vector<Interval, UntrackedAllocator<Interval>> Intervals;
+
+/**
+ * Blocked intervals of the calling task, and of every task that ended this wake
+ */
+thread_local uint64_t t_task_start_us = 0;
+thread_local Intervals t_waits;
+Intervals busy_intervals; // guarded by stats_lock
+Intervals radio_intervals; // guarded by stats_lock
+bool pm_low_clock = false;
+bool pm_light_sleep = false;
+
+std::atomic<uint32_t> allocations { 0 };
+std::atomic<uint64_t> allocated_bytes { 0 };
+std::atomic<int64_t> live_bytes { 0 };
+std::atomic<int64_t> peak_live_bytes { 0 };
+
+std::mutex tasks_lock;
+std::vector<std::thread> tasks;
+
+struct TaskExit { };
+
+extern "C" {
+extern uint8_t __start_rtc_data[] __attribute__((weak));
+extern uint8_t __stop_rtc_data[] __attribute__((weak));
+}
+
+size_t rtc_size() { return __start_rtc_data ? __stop_rtc_data - __start_rtc_data : 0; }
+
+bool read_fully(int fd, void* buffer, size_t size)
+{
+    uint8_t* cursor = static_cast<uint8_t*>(buffer);
+    while (size > 0) {
+        ssize_t got = read(fd, cursor, size);
+        if (got <= 0)
+            return false;
+        cursor += got;
+        size -= got;
+    }
+    return true;
+}
+
+void write_fully(int fd, const void* buffer, size_t size)
+{
+    const uint8_t* cursor = static_cast<const uint8_t*>(buffer);
+    while (size > 0) {
+        ssize_t put = write(fd, cursor, size);
+        if (put <= 0)
+            return;
+        cursor += put;
+        size -= put;
+    }
+}
+
+float noise(uint32_t channel, uint64_t slot)
+{
+    uint64_t x = (slot * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)channel << 32) ^ sim::config().seed;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (float)((x & 0xffff) / 32767.5 - 1.0);
+}
+
+double seconds() { return t_now_us / 1e6; }
+
+/**
+ * Adds the times the calling task was running, from its start until now, to busy_intervals
+ */
+void finish_task_timeline()
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    uint64_t running_from = t_task_start_us;
+    for (const Interval& wait : t_waits) {
+        if (wait.first > running_from)
+            busy_intervals.emplace_back(running_from, wait.first);
+        running_from = std::max(running_from, wait.second);
+    }
+    if (t_now_us > running_from)
+        busy_intervals.emplace_back(running_from, t_now_us);
+    t_waits.clear();
+}
+
+/**
+ * Sorts and merges overlapping intervals
+ */
+Intervals merged(Intervals intervals)
+{
+    std::sort(intervals.begin(), intervals.end());
+    Intervals result;
+    for (const Interval& interval : intervals) {
+        if (!result.empty() && interval.first <= result.back().second)
+            result.back().second = std::max(result.back().second, interval.second);
+        else
+            result.push_back(interval);
+    }
+    return result;
+}
+
+/**
+ * Length of [from, to) not covered by the merged intervals
+ */
+uint64_t uncovered_us(const Intervals& intervals, uint64_t from, uint64_t to)
+{
+    uint64_t covered = 0;
+    for (const Interval& interval : intervals) {
+        uint64_t first = std::max(interval.first, from);
+        uint64_t second = std::min(interval.second, to);
+        if (second > first)
+            covered += second - first;
+    }
+    return to - from - covered;
+}
+
+double daylight_factor()
+{
+    double day_fraction = fmod(seconds() / 86400.0, 1.0);
+    return std::max(0.0, sin(2 * kPi * (day_fraction - 0.25)));
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    size_t* block = static_cast<size_t*>(malloc(size + sizeof(max_align_t)));
+    if (!block)
+        throw std::bad_alloc();
+    *block = size;
+    allocations++;
+    allocated_bytes += size;
+    int64_t live = live_bytes += size;
+    int64_t peak = peak_live_bytes.load();
+    while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live)) { }
+    void* pointer = reinterpret_cast<char*>(block) + sizeof(max_align_t);
+    if (esp_heap_trace_alloc_hook)
+        esp_heap_trace_alloc_hook(pointer, size, MALLOC_CAP_8BIT);
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (!pointer)
+        return;
+    size_t* block = reinterpret_cast<size_t*>(static_cast<char*>(pointer) - sizeof(max_align_t));
+    if (esp_heap_trace_free_hook)
+        esp_heap_trace_free_hook(pointer);
+    live_bytes -= *block;
+    free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* pointer) noexcept { operator delete(pointer); }
+void operator delete(void* pointer, size_t) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { operator delete(pointer); }
+
+namespace sim {
+
+Config& config()
+{
+    static Config instance;
+    return instance;
+}
+
+uint64_t now_us() { return t_now_us; }
+uint64_t uptime_us() { return t_now_us - wake_start_us; }
+void advance_us(uint64_t us) { t_now_us += us; }
+void advance_ms(uint32_t ms) { t_now_us += (uint64_t)ms * 1000; }
+
+void wait_us(uint64_t us)
+{
+    if (us == 0)
+        return;
+    t_waits.emplace_back(t_now_us, t_now_us + us);
+    t_now_us += us;
+}
+
+void set_power_management(bool low_clock, bool light_sleep)
+{
+    pm_low_clock = low_clock;
+    pm_light_sleep = light_sleep;
+}
+
+/**
+ * Body of the child process of run_wake()
+ */
+static WakeStats wake(void (*setup_fn)())
+{
+    uint64_t start = station_time_us;
+    wake_start_us = start;
+    t_now_us = start + (uint64_t)config().boot_ms * 1000;
+    t_task_start_us = start;
+    uint32_t allocations_before = allocations;
+    uint64_t bytes_before = allocated_bytes;
+    int64_t live_before = live_bytes;
+    peak_live_bytes = live_before;
+
+    uint64_t sleep_us = 0;
+    bool restarted = false;
+    try {
+        setup_fn();
+    } catch (const DeepSleep& sleep) {
+        sleep_us = sleep.duration_us;
+    } catch (const Restart&) {
+        restarted = true;
+    }
+    finish_task_timeline();
+    join_tasks();
+    radio_off();
+
+    WakeStats stats = wake_stats;
+    stats.active_us = t_now_us - start;
+    if (pm_low_clock) {
+        // the CPU idles when no task is running
+        Intervals busy = merged(busy_intervals);
+        uint64_t idle_us = uncovered_us(busy, start, t_now_us);
+        if (pm_light_sleep) {
+            Intervals busy_or_radio = busy;
+            busy_or_radio.insert(busy_or_radio.end(), radio_intervals.begin(), radio_intervals.end());
+            stats.light_sleep_us = uncovered_us(merged(busy_or_radio), start, t_now_us);
+        }
+        stats.low_clock_us = idle_us - stats.light_sleep_us;
+    }
+    stats.sleep_us = sleep_us;
+    stats.restarted = restarted;
+    stats.allocations = allocations - allocations_before;
+    stats.allocated_bytes = allocated_bytes - bytes_before;
+    stats.peak_heap_bytes = (uint32_t)std::max<int64_t>(0, peak_live_bytes - live_before);
+    return stats;
+}
+
+WakeStats run_wake(void (*setup_fn)())
+{
+    int channel[2];
+    if (pipe(channel) != 0)
+        abort();
+    fflush(stdout);
+
+    pid_t child = fork();
+    if (child < 0)
+        abort();
+    if (child == 0) {
+        close(channel[0]);
+        WakeStats stats = wake(setup_fn);
+        fflush(stdout);
+        write_fully(channel[1], &stats, sizeof(stats));
+        write_fully(channel[1], __start_rtc_data, rtc_size());
+        _exit(0);
+    }
+
+    close(channel[1]);
+    WakeStats stats;
+    bool complete = read_fully(channel[0], &stats, sizeof(stats)) && read_fully(channel[0], __start_rtc_data, rtc_size());
+    close(channel[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!complete) {
+        fprintf(stderr, "sim: wake cycle crashed (status %d)\n", status);
+        abort();
+    }
+    station_time_us += stats.active_us + stats.sleep_us;
+    return stats;
+}
+
+void swap_station(Station& station)
+{
+    std::vector<uint8_t> current(__start_rtc_data, __start_rtc_data + rtc_size());
+    if (station.rtc_memory.size() == rtc_size())
+        memcpy(__start_rtc_data, station.rtc_memory.data(), rtc_size());
+    else if (!station.rtc_memory.empty())
+        abort();
+    station.rtc_memory.swap(current);
+    std::swap(station.time_us, station_time_us);
+}
+
+float temperature_c() { return 12.0f + 8.0f * (float)sin(2 * kPi * (seconds() / 86400.0 - 0.375)) + 0.05f * noise(1, t_now_us / 1000000); }
+float humidity() { return 70.0f - 2.5f * (temperature_c() - 12.0f) + 0.3f * noise(2, t_now_us / 1000000); }
+float pressure_pa() { return 101325.0f + 600.0f * (float)sin(2 * kPi * seconds() / (3 * 86400.0)) + 2.0f * noise(3, t_now_us / 1000000); }
+float illumination_lux() { return (float)(60000.0 * daylight_factor()) + 5.0f * noise(4, t_now_us / 1000000); }
+float battery_voltage() { return config().battery_voltage; }
+float solar_panel_voltage() { return (float)(config().solar_peak_voltage * std::min(1.0, 3 * daylight_factor())); }
+float uv_voltage() { return (float)(0.8 * daylight_factor() * daylight_factor()); }
+
+float pm_ugm3(int size_index)
+{
+    static const float base[] = { 6.0f, 9.0f, 11.0f, 12.0f };
+    float level = base[size_index] * (1.0f + 0.5f * (float)sin(2 * kPi * seconds() / 43200.0));
+    return std::max(0.0f, level * (1.0f + 0.15f * noise(10 + size_index, t_now_us / 1000000)));
+}
+
+void radio_on()
+{
+    if (!radio_state.exchange(true))
+        radio_on_since_us = t_now_us;
+}
+
+void radio_off()
+{
+    if (radio_state.exchange(false)) {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        wake_stats.radio_on_us += t_now_us - radio_on_since_us;
+        radio_intervals.emplace_back(radio_on_since_us, t_now_us);
+    }
+}
+
+bool radio_is_on() { return radio_state; }
+
+uint32_t heap_free() { return kHeapSize - (uint32_t)std::max<int64_t>(0, live_bytes); }
+uint32_t heap_min_free() { return kHeapSize - (uint32_t)std::max<int64_t>(0, peak_live_bytes); }
+
+void count_sent(size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    wake_stats.bytes_sent += bytes;
+}
+
+void count_request()
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    wake_stats.requests++;
+}
+
+void count_connection(bool tls)
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    wake_stats.connections++;
+    wake_stats.tls_handshakes += tls;
+}
+
+void count_points_written(uint32_t points)
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    wake_stats.points_written += points;
+}
+
+void count_i2c_transaction()
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    if (wake_stats.first_i2c_us == 0)
+        wake_stats.first_i2c_us = t_now_us - wake_start_us;
+}
+
+void count_sntp_sync()
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    wake_stats.sntp_syncs++;
+}
+
+void record_clock(bool synchronized, int64_t error_us)
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    wake_stats.clock_synchronized = synchronized;
+    wake_stats.clock_error_us = error_us;
+}
+
+void join_tasks()
+{
+    std::vector<std::thread> running;
+    {
+        std::lock_guard<std::mutex> guard(tasks_lock);
+        running.swap(tasks);
+    }
+    for (std::thread& task : running)
+        task.join();
+}
+
+} // namespace sim
+
+/* FreeRTOS */
+
+struct sim_task {
+    std::atomic<bool> deleted { false };
+};
+
+namespace {
+
+sim_task loop_task; // the task running setup()
+thread_local sim_task* t_current_task = &loop_task;
+
+} // namespace
+
+struct sim_semaphore {
+    std::mutex lock;
+    std::condition_variable changed;
+    bool available;
+    bool is_mutex;
+    uint64_t stamp_us = 0;
+};
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char*, uint32_t, void* parameters, UBaseType_t, TaskHandle_t* created_task)
+{
+    sim_task* task = new sim_task();
+    uint64_t parent_now = t_now_us;
+    if (created_task)
+        *created_task = task;
+    std::lock_guard<std::mutex> guard(tasks_lock);
+    tasks.emplace_back([=]() {
+        t_current_task = task;
+        t_now_us = parent_now;
+        t_task_start_us = parent_now;
+        try {
+            code(parameters);
+        } catch (const TaskExit&) {
+        }
+        finish_task_timeline();
+    });
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr)
+        throw TaskExit();
+    // A host thread cannot be killed; it runs to completion and is joined at the end of the wake.
+    task->deleted = true;
+}
+
+void vTaskDelay(TickType_t ticks) { sim::wait_us((uint64_t)ticks * portTICK_PERIOD_MS * 1000); }
+TickType_t xTaskGetTickCount() { return (TickType_t)(t_now_us / 1000 / portTICK_PERIOD_MS); }
+TaskHandle_t xTaskGetCurrentTaskHandle() { return t_current_task; }
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    sim_semaphore* semaphore = new sim_semaphore();
+    semaphore->available = false;
+    semaphore->is_mutex = false;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    sim_semaphore* semaphore = new sim_semaphore();
+    semaphore->available = true;
+    semaphore->is_mutex = true;
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    if (!semaphore->available) {
+        if (ticks_to_wait == 0)
+            return pdFALSE;
+        // Virtual delays take no real time, so a give that is going to happen at all happens promptly.
+        if (!semaphore->changed.wait_for(guard, std::chrono::seconds(5), [&] { return semaphore->available; })) {
+            if (ticks_to_wait != portMAX_DELAY)
+                sim::wait_us((uint64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000);
+            return pdFALSE;
+        }
+    }
+    if (!semaphore->is_mutex) {
+        uint64_t deadline = t_now_us + (uint64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000;
+        if (ticks_to_wait != portMAX_DELAY && semaphore->stamp_us > deadline) {
+            sim::wait_us(deadline - t_now_us);
+            return pdFALSE;
+        }
+        if (semaphore->stamp_us > t_now_us)
+            sim::wait_us(semaphore->stamp_us - t_now_us);
+    }
+    semaphore->available = false;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    semaphore->available = true;
+    semaphore->stamp_us = t_now_us;
+    semaphore->changed.notify_all();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
@@ -0,0 +1,208 @@
+#ifndef NATIVE_HAL_SIM_H
+#define NATIVE_HAL_SIM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Simulation core of the native HAL
+ *
+ * Every thread carries a virtual clock in microseconds; delay() and the mocked
+ * peripherals advance it instead of sleeping, so thousands of wake cycles run in
+ * a fraction of a second. The station's wall clock (time since the simulated
+ * power-on, including deep sleep) is the clock of the thread that calls setup().
+ */
+namespace sim {
+
+/**
+ * Knobs describing the simulated station and its surroundings
+ */
+struct Config {
+    bool bmp280_present = true;
+    uint8_t bmp280_address = 0x77;
+    bool aht20_present = true;
+    bool bh1750_present = true;
+    bool ads1115_present = true;
+    bool sps30_present = true;
+
+    bool wifi_available = true;
+    uint32_t wifi_scan_ms = 1200; // skipped by a directed connect to a known BSSID and channel
+    uint32_t wifi_association_ms = 300;
+    uint32_t dhcp_ms = 500; // skipped with a static IP configuration
+    uint32_t tcp_connect_ms = 60;
+    uint32_t tls_handshake_ms = 1800;
+    uint32_t http_response_ms = 250;
+    uint32_t sntp_ms = 150;
+    uint32_t boot_ms = 250; // wake-up from deep sleep to setup(): ROM, bootloader, image load
+    int64_t epoch_at_power_on = 1767225600; // 2026-01-01T00:00:00Z, midnight as in the environment model
+    int32_t rtc_drift_ppm = 0; // deep sleep timer error, positive = station clock runs fast
+    int http_status = 204;
+    uint32_t udp_rtt_ms = 4; // local network round trip
+    uint32_t uplink_kbps = 0; // effective rate of the station's transmissions for HTTP bodies; 0 = not modelled
+    /**
+     * Server side of UDP: gets each datagram sent and may write an answer to
+     * `reply`, returning its length (0 for none)
+     */
+    size_t (*udp_responder)(const uint8_t* datagram, size_t length, uint8_t* reply, size_t capacity) = nullptr;
+    /**
+     * Server side of HTTP: gets each request as it arrives and returns the HTTP
+     * status, setting `response_ms`; nullptr: every request gets http_status after
+     * http_response_ms
+     */
+    int (*http_responder)(const char* url, size_t request_bytes, uint32_t* response_ms) = nullptr;
+
+    /**
+     * Host directory holding the LittleFS files; nullptr for a board without a
+     * data partition
+     */
+    const char* flash_dir = nullptr;
+    uint32_t flash_mount_ms = 12;
+    uint32_t flash_read_us = 150; // per read() call and per open
+    uint32_t flash_write_us = 600; // per write() call
+    /**
+     * The access point is unreachable during [outage_start_s, outage_end_s) after power-on
+     */
+    uint32_t outage_start_s = 0;
+    uint32_t outage_end_s = 0;
+
+    float battery_voltage = 3.95f;
+    float solar_peak_voltage = 5.5f; // solar panel voltage at noon
+    uint32_t seed = 1;
+    bool echo_serial = false; // copy Serial output to stdout
+
+    bool power_management = true; // esp_pm_configure() is supported
+    bool light_sleep = true; // automatic light sleep is supported (tickless idle)
+};
+
+Config& config();
+
+/**
+ * Counters collected over one wake cycle (setup() until deep sleep or restart)
+ */
+struct WakeStats {
+    uint64_t active_us = 0;
+    uint64_t radio_on_us = 0;
+    uint64_t sleep_us = 0;
+    uint32_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    uint32_t peak_heap_bytes = 0;
+    uint32_t bytes_sent = 0;
+    uint32_t requests = 0;
+    uint32_t connections = 0; // TCP connections opened
+    uint32_t tls_handshakes = 0;
+    uint32_t points_written = 0; // "weather" lines accepted by InfluxDB
+    /**
+     * Parts of the active time in which every task was blocked (see wait_us()),
+     * spent at the lowest CPU clock or in automatic light sleep as configured
+     * with esp_pm_configure(). Light sleep needs the radio off.
+     */
+    uint64_t low_clock_us = 0;
+    uint64_t light_sleep_us = 0;
+    uint64_t first_i2c_us = 0; // from the wake-up to the first I2C transaction, boot included; 0: none
+    uint32_t sntp_syncs = 0;
+    /**
+     * System time minus true time at deep sleep, if the clock was synchronized
+     * since power-on
+     */
+    bool clock_synchronized = false;
+    int64_t clock_error_us = 0;
+    bool restarted = false;
+};
+
+/**
+ * Runs one wake cycle of a station
+ *
+ * setup_fn runs in a forked child process, so everything outside RTC memory
+ * starts from its boot state, as after a real deep sleep. Only the RTC_DATA_ATTR
+ * section is copied back. The station clock advances by the active time plus the
+ * requested deep sleep.
+ */
+WakeStats run_wake(void (*setup_fn)());
+
+/**
+ * Snapshot of a station's RTC memory and clock, for simulating several stations
+ * with one binary (see swap_station())
+ */
+struct Station {
+    std::vector<uint8_t> rtc_memory;
+    uint64_t time_us = 0;
+};
+
+/**
+ * Exchanges the current station state with the given one
+ */
+void swap_station(Station& station);
+
+/**
+ * Thread-local virtual time in microseconds since simulated power-on
+ */
+uint64_t now_us();
+
+/**
+ * Virtual time since the start of the current wake cycle, what millis() and
+ * esp_timer count on the chip
+ */
+uint64_t uptime_us();
+void advance_us(uint64_t us);
+void advance_ms(uint32_t ms);
+
+/**
+ * Advances the calling task's time while it is blocked (delay(), vTaskDelay(),
+ * semaphores), time in which the CPU may idle
+ */
+void wait_us(uint64_t us);
+
+/**
+ * Hook of esp_pm_configure()
+ */
+void set_power_management(bool low_clock, bool light_sleep);
+
+/**
+ * Environment model, a deterministic function of the virtual time
+ */
+float temperature_c();
+float humidity();
+float pressure_pa();
+float illumination_lux();
+float pm_ugm3(int size_index); // 0: PM1.0, 1: PM2.5, 2: PM4.0, 3: PM10.0
+float battery_voltage();
+float solar_panel_voltage();
+float uv_voltage();
+
+/**
+ * Hooks used by the mocks
+ */
+void radio_on();
+void radio_off();
+bool radio_is_on();
+uint32_t heap_free();
+uint32_t heap_min_free();
+void count_sent(size_t bytes);
+void count_request();
+void count_connection(bool tls);
+void count_points_written(uint32_t points);
+void count_i2c_transaction();
+void count_sntp_sync();
+void record_clock(bool synchronized, int64_t error_us);
+void join_tasks();
+
+/**
+ * Decompresses a gzip member with stored or fixed-Huffman deflate blocks, as
+ * servers would for Content-Encoding: gzip
+ *
+ * @return false if the data is malformed or uses dynamic Huffman codes
+ */
+bool gunzip(const uint8_t* data, size_t length, std::vector<uint8_t>& out);
+
+/**
+ * Thrown out of esp_deep_sleep_start() / ESP.restart() and caught by run_wake()
+ */
+struct DeepSleep {
+    uint64_t duration_us;
+};
+struct Restart { };
+
+} // namespace sim
+
+#endif // NATIVE_HAL_SIM_H
@@ -0,0 +1,92 @@
+#include "batch.h"
+#include "clock.h"
+#include "env.h"
+#include "influxdb.h"
+#include "outbox.h"
+#include "perf.h"
+#include "sensor_health.h"
+#include "utils.h"
+
+RTC_DATA_ATTR Measurement batch_points[INFLUXDB_BATCH_CAPACITY];
+RTC_DATA_ATTR uint8_t batch_oldest = 0;
+RTC_DATA_ATTR uint8_t batch_size = 0;
+
+// one line per point and per firmware_perf record and the firmware_sensors line, each followed by a newline
+static char batch_payload[INFLUXDB_BATCH_CAPACITY * (INFLUXDB_LINE_MAX_LENGTH + 1) + PERF_HISTORY_SIZE * (PERF_LINE_MAX_LENGTH + 1)
+    + 1 + SENSOR_HEALTH_LINE_MAX_LENGTH];
+
+void batch_add(const Measurement& measurement)
+{
+    uint8_t index = (batch_oldest + batch_size) % INFLUXDB_BATCH_CAPACITY;
+    if (batch_size == INFLUXDB_BATCH_CAPACITY) {
+        if (OUTBOX_ENABLED) {
+            LOG_WARN("Batch buffer full - moving the oldest point to the outbox.");
+            outbox_add(batch_points[batch_oldest]);
+        } else {
+            LOG_WARN("Batch buffer full - dropping the oldest point.");
+        }
+        batch_oldest = (batch_oldest + 1) % INFLUXDB_BATCH_CAPACITY;
+    } else {
+        batch_size++;
+    }
+
+    batch_points[index] = measurement;
+}
+
+bool batch_flush_due(uint8_t cycles, uint8_t pending)
+{
+    // keep one slot spare so a failed upload does not immediately start dropping points
+    unsigned int size = batch_size + pending;
+    return size >= cycles || size >= INFLUXDB_BATCH_CAPACITY - 1;
+}
+
+bool batch_flush(uint32_t timeout_ms)
+{
+    if (batch_size == 0)
+        return true;
+
+    unsigned long start = millis();
+    if (!clock_synchronized()) {
+        LOG_WARN("Clock not synchronized - keeping %u buffered points.", batch_size);
+        return false;
+    }
+    // points buffered before the first synchronization carry the time since power-on
+    for (uint8_t i = 0; i < batch_size; i++) {
+        Measurement& point = batch_points[(batch_oldest + i) % INFLUXDB_BATCH_CAPACITY];
+        if (point.timestamp < VALID_EPOCH)
+            point.timestamp += clock_offset();
+    }
+
+    PayloadWriter payload(batch_payload, sizeof(batch_payload));
+    for (uint8_t i = 0; i < batch_size; i++) {
+        if (payload.length() > 0)
+            payload.append('\n');
+        write_line_protocol(payload, batch_points[(batch_oldest + i) % INFLUXDB_BATCH_CAPACITY]);
+    }
+    uint8_t perf_records = perf_write_history(payload);
+    sensor_write_health(payload);
+    if (payload.overflowed()) {
+        // InfluxDB would reject the whole write for the cut line, on every retry; the outbox sends points a few at a time
+        LOG_ERROR("InfluxDB batch payload too long - not sending, %s %u points.", OUTBOX_ENABLED ? "moving to the outbox" : "dropping",
+            batch_size);
+        if (OUTBOX_ENABLED)
+            for (uint8_t i = 0; i < batch_size; i++)
+                outbox_add(batch_points[(batch_oldest + i) % INFLUXDB_BATCH_CAPACITY]);
+        perf_clear_history(perf_records);
+        batch_oldest = 0;
+        batch_size = 0;
+        return false;
+    }
+
+    uint32_t elapsed_ms = millis() - start;
+    if (elapsed_ms >= timeout_ms || !post_to_influx_db(payload.c_str(), payload.length(), timeout_ms - elapsed_ms))
+        return false;
+
+    LOG_INFO("Batch of %u points written.", batch_size);
+    perf_clear_history(perf_records);
+    batch_oldest = 0;
+    batch_size = 0;
+    return true;
+}
+
+uint8_t batch_count() { return batch_size; }
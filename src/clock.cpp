@@ -0,0 +1,149 @@
+#include "clock.h"
+#include "env.h"
+#include "utils.h"
+#include "wait.h"
+
+#include <esp_idf_version.h>
+#include <esp_sntp.h>
+
+#include <sys/time.h>
+#include <time.h>
+
+/**
+ * While the drift is not known yet, the clock is synchronized again this soon
+ * after the first time, to measure it
+ */
+#define CLOCK_FIRST_DRIFT_SYNC_S 3600
+
+/**
+ * Less deep sleep than this between synchronizations tells too little about the drift
+ */
+#define CLOCK_DRIFT_MIN_SLEEP_S 1800
+
+/**
+ * A larger drift is taken for a bad SNTP answer; even the uncalibrated RC
+ * oscillator of the RTC stays within 5 %
+ */
+#define CLOCK_MAX_DRIFT_PPM 50000
+
+/**
+ * Share of a new drift measurement in the estimate; the drift follows the
+ * temperature of the chip, so older measurements fade out
+ */
+#define CLOCK_DRIFT_WEIGHT 0.5f
+
+#define CLOCK_SYNC_TIMEOUT_MS 5000
+
+struct ClockState {
+    uint32_t synchronized_at; // time() after the last SNTP synchronization, 0: not since power-on
+    bool drift_known;
+    float drift_ppm; // estimated error of the RTC in deep sleep, positive = it runs fast
+    uint64_t slept_us; // deep sleep since the last synchronization
+    uint64_t sleep_us; // the deep sleep going on, 0: none (power-on or reset)
+};
+
+RTC_DATA_ATTR ClockState clock_state = {};
+
+/**
+ * What the first SNTP synchronization added to the system time, which counted
+ * seconds since power-on before
+ */
+RTC_DATA_ATTR uint32_t clock_sync_offset = 0;
+
+static int64_t to_us(const struct timeval& time) { return (int64_t)time.tv_sec * 1000000 + time.tv_usec; }
+
+static void update_drift(int64_t error_us);
+
+void clock_wake()
+{
+    if (clock_state.sleep_us == 0)
+        return;
+
+    // the RTC counted the sleep at its own rate; take back what the drift added
+    int64_t correction_us = (int64_t)(clock_state.sleep_us * 1e-6f * clock_state.drift_ppm);
+    if (correction_us != 0) {
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+        int64_t corrected_us = to_us(now) - correction_us;
+        now.tv_sec = corrected_us / 1000000;
+        now.tv_usec = corrected_us % 1000000;
+        settimeofday(&now, nullptr);
+    }
+    clock_state.slept_us += clock_state.sleep_us;
+    clock_state.sleep_us = 0;
+}
+
+void clock_sleep(uint64_t duration_us) { clock_state.sleep_us = duration_us; }
+
+bool clock_sync_due()
+{
+    uint32_t now = time(nullptr);
+    if (now < VALID_EPOCH)
+        return true;
+    uint32_t interval_s = clock_state.drift_known ? CLOCK_SYNC_INTERVAL_H * 3600 : CLOCK_FIRST_DRIFT_SYNC_S;
+    return now - clock_state.synchronized_at >= interval_s;
+}
+
+bool clock_synchronized() { return time(nullptr) >= VALID_EPOCH; }
+
+bool synchronize_clock(uint32_t timeout_ms)
+{
+    struct timeval before;
+    gettimeofday(&before, nullptr);
+    unsigned long sync_start = millis();
+
+    sntp_set_sync_status(SNTP_SYNC_STATUS_RESET);
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+    bool synchronized = wait_until([]() { return sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED; },
+        min(timeout_ms, (uint32_t)CLOCK_SYNC_TIMEOUT_MS));
+    // one answer is all it takes; the RTC keeps the time from here
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_sntp_stop();
+#else
+    sntp_stop();
+#endif
+    if (!synchronized) {
+        LOG_ERROR("Failed to obtain time over SNTP.");
+        return false;
+    }
+
+    struct timeval after;
+    gettimeofday(&after, nullptr);
+    uint32_t elapsed_ms = millis() - sync_start;
+    if (before.tv_sec < VALID_EPOCH) {
+        clock_sync_offset = after.tv_sec - (before.tv_sec + elapsed_ms / 1000);
+        LOG_INFO("Clock synchronized over SNTP.");
+    } else {
+        // where the clock would be now without the synchronization, against the server's time
+        update_drift(to_us(before) + (int64_t)elapsed_ms * 1000 - to_us(after));
+    }
+    clock_state.synchronized_at = after.tv_sec;
+    clock_state.slept_us = 0;
+    return true;
+}
+
+uint32_t clock_offset() { return clock_sync_offset; }
+
+/**
+ * Takes the error the clock had at a synchronization, positive if it was ahead,
+ * into the drift estimate
+ */
+static void update_drift(int64_t error_us)
+{
+    if (clock_state.slept_us < (uint64_t)CLOCK_DRIFT_MIN_SLEEP_S * 1000000) {
+        LOG_INFO("Clock synchronized over SNTP, it was off by %ld ms.", (long)(error_us / 1000));
+        return;
+    }
+
+    // the error is what the current estimate left uncorrected
+    float residual_ppm = (float)error_us / clock_state.slept_us * 1e6f;
+    float drift_ppm = clock_state.drift_ppm + (clock_state.drift_known ? CLOCK_DRIFT_WEIGHT : 1.0f) * residual_ppm;
+    LOG_INFO("Clock synchronized over SNTP, it was off by %ld ms after %lu s of deep sleep - RTC drift %.0f ppm.",
+        (long)(error_us / 1000), (unsigned long)(clock_state.slept_us / 1000000), drift_ppm);
+    if (fabsf(drift_ppm) > CLOCK_MAX_DRIFT_PPM) {
+        LOG_WARN("RTC drift implausible - keeping the estimate of %.0f ppm.", clock_state.drift_ppm);
+        return;
+    }
+    clock_state.drift_ppm = drift_ppm;
+    clock_state.drift_known = true;
+}
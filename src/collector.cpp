@@ -0,0 +1,116 @@
+#include "collector.h"
+#include "collector_packet.h"
+#include "env.h"
+#include "utils.h"
+#include "wait.h"
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+static_assert(COLLECTOR_FIELD_COUNT == Measurement::FIELD_COUNT, "collector_packet.h is out of sync with Measurement::Field");
+
+/**
+ * Datagram sequence number, per station, to match ACKs and let the collector drop duplicates
+ */
+RTC_DATA_ATTR uint16_t collector_sequence = 0;
+
+/**
+ * Drawn when the sequence starts at 0, after a power-on, brownout or reset (collector_packet.h); never 0
+ */
+RTC_DATA_ATTR uint16_t collector_boot = 0;
+
+static bool wait_for_ack(WiFiUDP& udp, uint16_t sequence, uint32_t timeout_ms);
+
+/**
+ * Takes the next sequence number; the point and the log are sent from different upload tasks
+ */
+static uint16_t next_sequence()
+{
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    while (collector_boot == 0)
+        collector_boot = (uint16_t)esp_random();
+    uint16_t sequence = collector_sequence++;
+    xSemaphoreGive(lock);
+    return sequence;
+}
+
+bool send_to_collector(const Measurement& measurement, uint32_t timeout_ms)
+{
+    if (WiFi.status() != WL_CONNECTED) {
+        LOG_ERROR("WiFi not connected");
+        return false;
+    }
+
+    CollectorPoint point;
+    point.timestamp = measurement.timestamp;
+    point.present = measurement.present;
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++)
+        point.values[i] = measurement.values[i];
+
+    uint16_t sequence = next_sequence();
+    uint8_t datagram[COLLECTOR_POINT_MAX_LENGTH];
+    size_t length = collector_encode_point(datagram, sizeof(datagram), COLLECTOR_STATION_ID, collector_boot, sequence,
+        COLLECTOR_REQUEST_ACK ? COLLECTOR_FLAG_ACK_REQUESTED : 0, point);
+
+    WiFiUDP udp;
+    udp.begin(COLLECTOR_PORT);
+    unsigned long start = millis();
+    bool delivered = false;
+    for (uint8_t attempt = 0; attempt < 2 && !delivered; attempt++) {
+        udp.beginPacket(COLLECTOR_HOST, COLLECTOR_PORT);
+        udp.write(datagram, length);
+        if (!udp.endPacket()) {
+            LOG_ERROR("Collector: could not send datagram %u.", sequence);
+            break;
+        }
+        if (!COLLECTOR_REQUEST_ACK) {
+            delivered = true;
+            break;
+        }
+        long remaining_ms = (long)(timeout_ms - (millis() - start));
+        delivered = remaining_ms > 0 && wait_for_ack(udp, sequence, min((long)COLLECTOR_ACK_TIMEOUT_MS, remaining_ms));
+        if (!delivered)
+            LOG_WARN("Collector: no ACK for datagram %u (attempt %u).", sequence, attempt + 1);
+    }
+    udp.stop();
+
+    if (delivered)
+        LOG_INFO("Collector: sent %u bytes.", (unsigned int)length);
+    return delivered;
+}
+
+void send_log_to_collector(const char* text, size_t length)
+{
+    WiFiUDP udp;
+    udp.begin(COLLECTOR_PORT);
+    uint8_t datagram[COLLECTOR_HEADER_LENGTH + COLLECTOR_LOG_CHUNK_SIZE + COLLECTOR_CRC_LENGTH];
+    for (size_t sent = 0; sent < length;) {
+        size_t chunk = min((size_t)COLLECTOR_LOG_CHUNK_SIZE, length - sent);
+        uint16_t sequence = next_sequence(); // draws collector_boot first
+        size_t datagram_length = collector_encode_log(
+            datagram, sizeof(datagram), COLLECTOR_STATION_ID, collector_boot, sequence, text + sent, chunk);
+        udp.beginPacket(COLLECTOR_HOST, COLLECTOR_PORT);
+        udp.write(datagram, datagram_length);
+        udp.endPacket();
+        sent += chunk;
+    }
+    udp.stop();
+}
+
+static bool wait_for_ack(WiFiUDP& udp, uint16_t sequence, uint32_t timeout_ms)
+{
+    return wait_until(
+        [&]() {
+            if (udp.parsePacket() <= 0)
+                return false;
+            uint8_t reply[COLLECTOR_ACK_LENGTH + 1];
+            int length = udp.read(reply, sizeof(reply));
+            CollectorPacket packet;
+            return length > 0 && collector_decode(reply, length, packet) && packet.type == COLLECTOR_ACK
+                && packet.station_id == COLLECTOR_STATION_ID && packet.boot == collector_boot && packet.sequence == sequence;
+        },
+        timeout_ms, 5);
+}
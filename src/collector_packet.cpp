@@ -0,0 +1,187 @@
+#include "collector_packet.h"
+#include "fields.h"
+
+#include <math.h>
+#include <string.h>
+
+static_assert(COLLECTOR_FIELD_COUNT == FIELD_DESCRIPTOR_COUNT, "collector_packet.h is out of sync with fields.h");
+
+static void put_u16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xff;
+    out[1] = value >> 8;
+}
+
+static void put_u32(uint8_t* out, uint32_t value)
+{
+    put_u16(out, value & 0xffff);
+    put_u16(out + 2, value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t* in) { return in[0] | (in[1] << 8); }
+static uint32_t get_u32(const uint8_t* in) { return get_u16(in) | ((uint32_t)get_u16(in + 2) << 16); }
+
+uint16_t crc16_ccitt(const uint8_t* data, size_t length)
+{
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+/**
+ * Writes the header, leaving the body to the caller
+ */
+static void write_header(
+    uint8_t* out, CollectorPacketType type, uint8_t flags, uint32_t station_id, uint16_t boot, uint16_t sequence)
+{
+    out[0] = COLLECTOR_PACKET_MAGIC;
+    out[1] = COLLECTOR_PACKET_VERSION;
+    out[2] = type;
+    out[3] = flags;
+    put_u32(out + 4, station_id);
+    put_u16(out + 8, sequence);
+    put_u16(out + 10, boot);
+}
+
+/**
+ * Appends the CRC after `length` bytes and returns the full datagram length
+ */
+static size_t finish(uint8_t* out, size_t length)
+{
+    put_u16(out + length, crc16_ccitt(out, length));
+    return length + COLLECTOR_CRC_LENGTH;
+}
+
+static uint16_t pack_value(const FieldDescriptor& field, float value)
+{
+    float scaled = roundf(value * field.collector_scale);
+    if (isnan(scaled))
+        scaled = 0;
+    if (field.collector_signed)
+        return (uint16_t)(int16_t)fmaxf(-32768.0f, fminf(32767.0f, scaled));
+    return (uint16_t)fmaxf(0.0f, fminf(65535.0f, scaled));
+}
+
+static float unpack_value(const FieldDescriptor& field, uint16_t raw)
+{
+    return (field.collector_signed ? (float)(int16_t)raw : (float)raw) / field.collector_scale;
+}
+
+size_t collector_encode_point(uint8_t* out, size_t capacity, uint32_t station_id, uint16_t boot, uint16_t sequence,
+    uint8_t flags, const CollectorPoint& point)
+{
+    if (capacity < COLLECTOR_POINT_MAX_LENGTH)
+        return 0;
+
+    uint16_t present = 0;
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++)
+        if ((point.present & (1u << i)) && field_descriptors[i].collector_scale != 0)
+            present |= 1u << i;
+
+    write_header(out, COLLECTOR_POINT, flags, station_id, boot, sequence);
+    put_u32(out + COLLECTOR_HEADER_LENGTH, point.timestamp);
+    put_u16(out + COLLECTOR_HEADER_LENGTH + 4, present);
+    size_t length = COLLECTOR_HEADER_LENGTH + 6;
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++) {
+        if (present & (1u << i)) {
+            put_u16(out + length, pack_value(field_descriptors[i], point.values[i]));
+            length += 2;
+        }
+    }
+    return finish(out, length);
+}
+
+size_t collector_encode_ack(uint8_t* out, size_t capacity, uint32_t station_id, uint16_t boot, uint16_t sequence)
+{
+    if (capacity < COLLECTOR_ACK_LENGTH)
+        return 0;
+    write_header(out, COLLECTOR_ACK, 0, station_id, boot, sequence);
+    return finish(out, COLLECTOR_HEADER_LENGTH);
+}
+
+size_t collector_encode_log(uint8_t* out, size_t capacity, uint32_t station_id, uint16_t boot, uint16_t sequence,
+    const char* text, size_t length)
+{
+    if (capacity < COLLECTOR_HEADER_LENGTH + length + COLLECTOR_CRC_LENGTH)
+        return 0;
+    write_header(out, COLLECTOR_LOG, 0, station_id, boot, sequence);
+    memcpy(out + COLLECTOR_HEADER_LENGTH, text, length);
+    return finish(out, COLLECTOR_HEADER_LENGTH + length);
+}
+
+bool collector_decode(const uint8_t* data, size_t length, CollectorPacket& packet)
+{
+    if (length < COLLECTOR_HEADER_LENGTH + COLLECTOR_CRC_LENGTH)
+        return false;
+    if (data[0] != COLLECTOR_PACKET_MAGIC || data[1] != COLLECTOR_PACKET_VERSION)
+        return false;
+    size_t crc_offset = length - COLLECTOR_CRC_LENGTH;
+    if (get_u16(data + crc_offset) != crc16_ccitt(data, crc_offset))
+        return false;
+
+    packet.type = (CollectorPacketType)data[2];
+    packet.flags = data[3];
+    packet.station_id = get_u32(data + 4);
+    packet.sequence = get_u16(data + 8);
+    packet.boot = get_u16(data + 10);
+    packet.body = data + COLLECTOR_HEADER_LENGTH;
+    packet.body_length = crc_offset - COLLECTOR_HEADER_LENGTH;
+    return true;
+}
+
+bool collector_decode_point(const CollectorPacket& packet, CollectorPoint& point)
+{
+    if (packet.type != COLLECTOR_POINT || packet.body_length < 6)
+        return false;
+
+    point.timestamp = get_u32(packet.body);
+    point.present = get_u16(packet.body + 4);
+    size_t offset = 6;
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++) {
+        point.values[i] = 0;
+        if (!(point.present & (1u << i)))
+            continue;
+        if (field_descriptors[i].collector_scale == 0 || offset + 2 > packet.body_length)
+            return false;
+        point.values[i] = unpack_value(field_descriptors[i], get_u16(packet.body + offset));
+        offset += 2;
+    }
+    return offset == packet.body_length;
+}
+
+bool collector_seen_recently(CollectorRecent& recent, const CollectorPacket& packet)
+{
+    if (recent.count > 0 && recent.boot != packet.boot) {
+        // the station lost its RTC memory, and counts from 0 again
+        recent.count = 0;
+        recent.next = 0;
+    }
+    recent.boot = packet.boot;
+    for (uint8_t i = 0; i < recent.count; i++)
+        if (recent.sequences[i] == packet.sequence)
+            return true;
+    recent.sequences[recent.next] = packet.sequence;
+    recent.next = (recent.next + 1) % COLLECTOR_RECENT_SEQUENCES;
+    if (recent.count < COLLECTOR_RECENT_SEQUENCES)
+        recent.count++;
+    return false;
+}
+
+void collector_write_line_protocol(PayloadWriter& line, uint32_t station_id, const CollectorPoint& point)
+{
+    line.append("weather,station=").append(station_id).append(' ');
+    bool first = true;
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++) {
+        if (!(point.present & (1u << i)) || field_descriptors[i].influx_name == nullptr)
+            continue;
+        if (!first)
+            line.append(',');
+        line.append(field_descriptors[i].influx_name).append('=').append(point.values[i], field_descriptors[i].decimals);
+        first = false;
+    }
+    line.append(' ').append(point.timestamp);
+}
@@ -0,0 +1,58 @@
+#include "deadband.h"
+#include "env.h"
+#include "utils.h"
+
+#include <math.h>
+
+RTC_DATA_ATTR Measurement deadband_reference;
+RTC_DATA_ATTR uint16_t deadband_cycles_since_report = 0;
+
+/**
+ * Largest change of a field that is not reported, by FieldQuantity
+ */
+static const float deadband_thresholds[QUANTITY_COUNT] = {
+    0, // QUANTITY_DERIVED
+    DEADBAND_TEMPERATURE_C, // QUANTITY_TEMPERATURE
+    DEADBAND_HUMIDITY, // QUANTITY_HUMIDITY
+    DEADBAND_PRESSURE_HPA, // QUANTITY_PRESSURE
+    DEADBAND_ILLUMINATION, // QUANTITY_ILLUMINATION
+    DEADBAND_VOLTAGE, // QUANTITY_VOLTAGE
+    DEADBAND_PARTICULATE_MATTER, // QUANTITY_PARTICULATE_MATTER
+};
+
+bool deadband_exceeded(const Measurement& measurement)
+{
+    if (deadband_cycles_since_report + 1 >= DEADBAND_HEARTBEAT_CYCLES)
+        return true;
+
+    for (uint8_t i = 0; i < Measurement::FIELD_COUNT; i++) {
+        Measurement::Field field = (Measurement::Field)i;
+        float threshold = deadband_thresholds[field_descriptors[i].quantity];
+        if (threshold <= 0 || !measurement.has(field))
+            continue;
+        if (!deadband_reference.has(field))
+            return true;
+        if (fabsf(measurement.get(field) - deadband_reference.get(field)) > threshold) {
+            LOG_DEBUG("Deadband: field %u changed by %.2f.", i, measurement.get(field) - deadband_reference.get(field));
+            return true;
+        }
+    }
+    return false;
+}
+
+void deadband_reported(const Measurement& measurement)
+{
+    // fields missing this cycle keep their last reported value
+    for (uint8_t i = 0; i < Measurement::FIELD_COUNT; i++) {
+        Measurement::Field field = (Measurement::Field)i;
+        if (measurement.has(field))
+            deadband_reference.set(field, measurement.get(field));
+    }
+    deadband_cycles_since_report = 0;
+}
+
+void deadband_skipped()
+{
+    if (deadband_cycles_since_report < UINT16_MAX)
+        deadband_cycles_since_report++;
+}
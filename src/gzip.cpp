@@ -0,0 +1,208 @@
+#include "gzip.h"
+
+#include <string.h>
+
+#define GZIP_HASH_BITS 10
+#define GZIP_HASH_SIZE (1 << GZIP_HASH_BITS)
+
+/**
+ * Candidates followed per position; more finds slightly longer matches at a
+ * proportional cost in time
+ */
+#define GZIP_MAX_CHAIN 32
+
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+
+static_assert((GZIP_WINDOW_SIZE & (GZIP_WINDOW_SIZE - 1)) == 0, "GZIP_WINDOW_SIZE must be a power of two");
+static_assert(GZIP_WINDOW_SIZE <= 32768, "deflate distances reach back 32 KB at most");
+
+/**
+ * Most recent position + 1 of each 3-byte hash (0: none), and for every position
+ * in the window the previous one with the same hash
+ */
+static uint16_t hash_head[GZIP_HASH_SIZE];
+static uint16_t hash_prev[GZIP_WINDOW_SIZE];
+
+// RFC 1951, 3.2.5: length symbols 257..285 and distance symbols 0..29
+static const uint16_t length_base[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115,
+    131, 163, 195, 227, 258 };
+static const uint8_t length_extra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distance_base[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+    2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distance_extra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13,
+    13 };
+
+/**
+ * Deflate bit stream: values are packed starting at the least significant bit,
+ * Huffman codes starting at their most significant bit
+ */
+struct BitWriter {
+    uint8_t* out;
+    size_t capacity;
+    size_t length;
+    uint32_t bits;
+    uint8_t bit_count;
+    bool overflow;
+
+    void put_bits(uint32_t value, uint8_t count)
+    {
+        bits |= value << bit_count;
+        bit_count += count;
+        while (bit_count >= 8) {
+            put_byte(bits & 0xff);
+            bits >>= 8;
+            bit_count -= 8;
+        }
+    }
+
+    void put_code(uint32_t code, uint8_t count)
+    {
+        uint32_t reversed = 0;
+        for (uint8_t i = 0; i < count; i++)
+            reversed |= ((code >> i) & 1) << (count - 1 - i);
+        put_bits(reversed, count);
+    }
+
+    void put_byte(uint8_t value)
+    {
+        if (length < capacity)
+            out[length++] = value;
+        else
+            overflow = true;
+    }
+
+    void flush()
+    {
+        if (bit_count > 0)
+            put_byte(bits & 0xff);
+        bits = 0;
+        bit_count = 0;
+    }
+};
+
+static void put_literal_or_length(BitWriter& writer, uint16_t symbol);
+static void put_match(BitWriter& writer, uint16_t length, uint16_t distance);
+static uint16_t hash_at(const uint8_t* data);
+
+size_t gzip_compress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity)
+{
+    if (length > GZIP_MAX_INPUT)
+        return 0;
+
+    BitWriter writer = { output, capacity, 0, 0, 0, false };
+    // ID1 ID2 CM=deflate FLG=0 MTIME=0 XFL=0 OS=unknown
+    static const uint8_t header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 };
+    for (uint8_t byte : header)
+        writer.put_byte(byte);
+
+    // one final block with the fixed codes
+    writer.put_bits(1, 1);
+    writer.put_bits(1, 2);
+
+    memset(hash_head, 0, sizeof(hash_head));
+    size_t position = 0;
+    while (position < length && !writer.overflow) {
+        uint16_t best_length = 0;
+        uint16_t best_distance = 0;
+        if (position + GZIP_MIN_MATCH <= length) {
+            uint16_t hash = hash_at(input + position);
+            uint16_t candidate = hash_head[hash];
+            size_t max_length = length - position < GZIP_MAX_MATCH ? length - position : GZIP_MAX_MATCH;
+            for (uint8_t chain = 0; candidate != 0 && chain < GZIP_MAX_CHAIN; chain++) {
+                size_t match = candidate - 1;
+                if (position - match > GZIP_WINDOW_SIZE)
+                    break;
+                uint16_t match_length = 0;
+                while (match_length < max_length && input[match + match_length] == input[position + match_length])
+                    match_length++;
+                if (match_length > best_length) {
+                    best_length = match_length;
+                    best_distance = position - match;
+                    if (match_length == max_length)
+                        break;
+                }
+                candidate = hash_prev[match & (GZIP_WINDOW_SIZE - 1)];
+            }
+        }
+
+        uint16_t advance = 1;
+        if (best_length >= GZIP_MIN_MATCH) {
+            put_match(writer, best_length, best_distance);
+            advance = best_length;
+        } else {
+            put_literal_or_length(writer, input[position]);
+        }
+
+        // every position covered goes into the tables, so later lines find the whole repeat
+        for (; advance > 0; advance--, position++) {
+            if (position + GZIP_MIN_MATCH > length)
+                continue;
+            uint16_t hash = hash_at(input + position);
+            hash_prev[position & (GZIP_WINDOW_SIZE - 1)] = hash_head[hash];
+            hash_head[hash] = position + 1;
+        }
+    }
+
+    put_literal_or_length(writer, 256); // end of block
+    writer.flush();
+
+    uint32_t crc = crc32_ieee(input, length);
+    for (uint8_t i = 0; i < 4; i++)
+        writer.put_byte(crc >> (8 * i));
+    for (uint8_t i = 0; i < 4; i++)
+        writer.put_byte(length >> (8 * i));
+
+    return writer.overflow ? 0 : writer.length;
+}
+
+uint32_t crc32_ieee(const uint8_t* data, size_t length, uint32_t crc)
+{
+    // a nibble at a time, so the table is 64 bytes instead of 1 KB
+    static const uint32_t table[16] = { 0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c };
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+/**
+ * Writes a literal byte, the end-of-block marker (256) or a length symbol (257..285)
+ * with the fixed literal/length code
+ */
+static void put_literal_or_length(BitWriter& writer, uint16_t symbol)
+{
+    if (symbol < 144)
+        writer.put_code(0x30 + symbol, 8);
+    else if (symbol < 256)
+        writer.put_code(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        writer.put_code(symbol - 256, 7);
+    else
+        writer.put_code(0xc0 + symbol - 280, 8);
+}
+
+static void put_match(BitWriter& writer, uint16_t length, uint16_t distance)
+{
+    uint8_t code = sizeof(length_base) / sizeof(length_base[0]) - 1;
+    while (length_base[code] > length)
+        code--;
+    put_literal_or_length(writer, 257 + code);
+    writer.put_bits(length - length_base[code], length_extra[code]);
+
+    code = sizeof(distance_base) / sizeof(distance_base[0]) - 1;
+    while (distance_base[code] > distance)
+        code--;
+    writer.put_code(code, 5);
+    writer.put_bits(distance - distance_base[code], distance_extra[code]);
+}
+
+static uint16_t hash_at(const uint8_t* data)
+{
+    uint32_t key = data[0] | (data[1] << 8) | (data[2] << 16);
+    return (key * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
@@ -0,0 +1,133 @@
+#include "heap_stats.h"
+#include "utils.h"
+
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+
+static_assert(PERF_PHASE_COUNT <= 32, "the open phases are a 32-bit mask");
+
+/**
+ * Allocations per cycle, in PerfPhase order
+ */
+static const uint16_t allocation_budgets[PERF_PHASE_COUNT] = {
+    HEAP_NO_BUDGET, // boot
+    HEAP_NO_BUDGET, // first_i2c
+    0, // bmp280_begin
+    0, // bmp280_read
+    0, // aht20_begin
+    0, // aht20_read
+    0, // bh1750_begin
+    0, // bh1750_read
+    0, // ads1115_begin
+    0, // ads1115_read
+    0, // sps30_warmup
+    0, // sps30_sampling
+    HEAP_NO_BUDGET, // wifi_connect
+    HEAP_NO_BUDGET, // clock_sync
+    HEAP_NO_BUDGET, // wunderground
+    HEAP_NO_BUDGET, // influxdb
+    HEAP_NO_BUDGET, // collector
+    HEAP_NO_BUDGET, // outbox
+    HEAP_NO_BUDGET, // send_log
+    HEAP_NO_BUDGET, // active
+};
+
+/**
+ * Every allocation since power-up, from any task or ISR; counted by the allocation hook
+ */
+static std::atomic<uint32_t> allocations(0);
+static std::atomic<uint32_t> allocated_bytes(0);
+
+struct PhaseStart {
+    uint32_t allocations;
+    uint32_t allocated_bytes;
+    uint32_t free_bytes;
+    uint32_t minimum_free_bytes; // since power-up
+};
+
+static std::atomic<uint32_t> open_phases(0); // bit n: phase n is open
+static std::atomic<uint32_t> shared_phases(0); // bit n: another task had a phase open during this run of phase n
+static TaskHandle_t phase_tasks[PERF_PHASE_COUNT];
+static PhaseStart phase_starts[PERF_PHASE_COUNT];
+static HeapPhaseStats phase_stats[PERF_PHASE_COUNT];
+
+#if CONFIG_HEAP_USE_HOOKS
+/**
+ * Runs on every allocation, also from ISRs and with the flash cache disabled: it
+ * only bumps the counters, which the phases read at their start and end
+ */
+void IRAM_ATTR esp_heap_trace_alloc_hook(void*, size_t size, uint32_t)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void*) { }
+#endif
+
+void heap_phase_begin(PerfPhase phase)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    phase_starts[phase] = { allocations.load(std::memory_order_relaxed), allocated_bytes.load(std::memory_order_relaxed),
+        (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT), (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT) };
+    phase_tasks[phase] = task;
+
+    // of two phases opening at the same time in different tasks, the later one sees the earlier
+    uint32_t open = open_phases.fetch_or(1u << phase);
+    uint32_t others = 0;
+    for (uint8_t other = 0; open >> other != 0; other++)
+        if ((open & (1u << other)) && phase_tasks[other] != task)
+            others |= 1u << other;
+    if (others != 0)
+        shared_phases.fetch_or(others | (1u << phase));
+}
+
+void heap_phase_end(PerfPhase phase)
+{
+    const PhaseStart& start = phase_starts[phase];
+    HeapPhaseStats& stats = phase_stats[phase];
+    uint32_t run_allocations = allocations.load(std::memory_order_relaxed) - start.allocations;
+    stats.allocated_bytes += allocated_bytes.load(std::memory_order_relaxed) - start.allocated_bytes;
+    open_phases.fetch_and(~(1u << phase));
+    bool shared = shared_phases.fetch_and(~(1u << phase)) & (1u << phase);
+
+    stats.allocations = min<uint32_t>(0xffff, stats.allocations + run_allocations);
+    if (!shared) {
+        stats.own_allocations = min<uint32_t>(0xffff, stats.own_allocations + run_allocations);
+        stats.own_runs++;
+    }
+
+    // the heap's low-water mark only tells about this run if the run set a new one
+    uint32_t lowest_free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    uint32_t minimum_free_bytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    if (minimum_free_bytes < start.minimum_free_bytes)
+        lowest_free_bytes = min(lowest_free_bytes, minimum_free_bytes);
+    if (lowest_free_bytes < start.free_bytes && start.free_bytes - lowest_free_bytes > stats.peak_bytes)
+        stats.peak_bytes = start.free_bytes - lowest_free_bytes;
+    uint32_t largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (stats.largest_free_block == 0 || largest_free_block < stats.largest_free_block)
+        stats.largest_free_block = largest_free_block;
+}
+
+void heap_finish_cycle()
+{
+    for (uint8_t i = 0; i < PERF_PHASE_COUNT; i++) {
+        PerfPhase phase = (PerfPhase)i;
+        const HeapPhaseStats& stats = phase_stats[phase];
+        if (stats.allocations == 0 && stats.peak_bytes == 0)
+            continue;
+        LOG_DEBUG("Heap in %s: %u allocations, %lu bytes, peak %lu bytes, largest free block %lu bytes.",
+            perf_phase_name(phase), stats.allocations, (unsigned long)stats.allocated_bytes, (unsigned long)stats.peak_bytes,
+            (unsigned long)stats.largest_free_block);
+        if (HEAP_COUNTS_ALLOCATIONS && stats.own_allocations > allocation_budgets[phase])
+            LOG_WARN("%s made %u allocations - its budget is %u.", perf_phase_name(phase), stats.own_allocations,
+                allocation_budgets[phase]);
+    }
+}
+
+const HeapPhaseStats& heap_phase_stats(PerfPhase phase) { return phase_stats[phase]; }
+
+uint16_t heap_allocation_budget(PerfPhase phase) { return allocation_budgets[phase]; }
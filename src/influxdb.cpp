@@ -1,69 +1,140 @@
 #include "influxdb.h"
+#include "clock.h"
 #include "env.h"
+#include "gzip.h"
 #include "measurement.h"
+#include "perf.h"
+#include "sensor_health.h"
 #include "utils.h"
+#include "wait.h"
 
 #include <HTTPClient.h>
 #include <WiFi.h>
 
-void send_to_influx_db(const Measurement& measurement)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/**
+ * Compressed payloads larger than this are sent as they are; line protocol
+ * compresses about 3.5:1, so this covers a full batch
+ */
+#define INFLUXDB_GZIP_BUFFER_SIZE 6144
+
+static uint8_t gzip_buffer[INFLUXDB_GZIP_BUFFER_SIZE];
+
+/**
+ * Writes in one wake reuse their connection (HTTP keep-alive), so an https://
+ * INFLUXDB_HOSTNAME costs one TLS handshake per wake rather than one per write.
+ * Upload tasks writing at the same time take turns on it: a second TLS session
+ * would add another ~40 KB of mbedTLS buffers to the peak heap of the uploads.
+ */
+static HTTPClient http;
+
+static SemaphoreHandle_t connection_lock()
 {
-    if (WiFi.status() == WL_CONNECTED) {
-        HTTPClient http;
-
-        String request_url = String(INFLUXDB_HOSTNAME) + "/api/v2/write?" + "bucket=" + String(INFLUXDB_BUCKET) + "&precision=s";
-
-        serial_log("Sending data to InfluxDB...");
-
-        http.begin(request_url);
-        http.setTimeout(10000); // 10s
-
-        http.addHeader("Authorization", "Token " + String(INFLUXDB_API_TOKEN));
-        http.addHeader("Content-Type", "text/plain; charset=utf-8");
-        http.addHeader("Accept", "application/json");
-
-        // Format: "weather temperature=XX.XX,humidity=XX.X,pressure=XX.XX,..."
-        String payload = String("weather ");
-        if (measurement.temperature_c)
-            payload += "temperature=" + String(*measurement.temperature_c, 2) + ",";
-        if (measurement.dew_point_c)
-            payload += "dew_point=" + String(*measurement.dew_point_c, 2) + ",";
-        if (measurement.humidity)
-            payload += "humidity=" + String(*measurement.humidity, 1) + ",";
-        if (measurement.pressure_hpa)
-            payload += "pressure=" + String(*measurement.pressure_hpa, 2) + ",";
-        if (measurement.illumination)
-            payload += "illumination=" + String(*measurement.illumination, 1) + ",";
-        if (measurement.battery_voltage_a0)
-            payload += "battery_voltage=" + String(*measurement.battery_voltage_a0, 2) + ",";
-        if (measurement.solar_panel_voltage_a1)
-            payload += "solar_panel_voltage=" + String(*measurement.solar_panel_voltage_a1, 2) + ",";
-        if (measurement.uv_voltage_a2)
-            payload += "uv_voltage=" + String(*measurement.uv_voltage_a2, 2) + ",";
-        if (measurement.mc_pm1_0)
-            payload += "mc_pm1_0=" + String(*measurement.mc_pm1_0, 2) + ",";
-        if (measurement.mc_pm2_5)
-            payload += "mc_pm2_5=" + String(*measurement.mc_pm2_5, 2) + ",";
-        if (measurement.mc_pm10_0)
-            payload += "mc_pm10_0=" + String(*measurement.mc_pm10_0, 2) + ",";
-
-        if (payload.endsWith(","))
-            payload.remove(payload.length() - 1);
-
-        int response_code = http.POST(payload);
-        serial_log(payload);
-
-        if (response_code > 0) {
-            serial_log("HTTP Response Code: ");
-            serial_log(String(response_code));
-        } else {
-            serial_log("Error in HTTP request: ");
-            serial_log(String(response_code));
-        }
-
-        delay(10);
-        http.end();
+    // also guards gzip_buffer and the encoder's tables
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    return lock;
+}
+
+void write_line_protocol(PayloadWriter& line, const Measurement& measurement)
+{
+    // Format: "weather temperature=XX.XX,humidity=XX.X,pressure=XX.XX,... [timestamp]"
+    line.append("weather ");
+    bool first = true;
+    for (uint8_t i = 0; i < Measurement::FIELD_COUNT; i++) {
+        const FieldDescriptor& descriptor = field_descriptors[i];
+        if (descriptor.influx_name == nullptr || !measurement.has((Measurement::Field)i))
+            continue;
+        if (!first)
+            line.append(',');
+        line.append(descriptor.influx_name).append('=').append(measurement.get((Measurement::Field)i), descriptor.decimals);
+        first = false;
+    }
+
+    if (measurement.timestamp >= VALID_EPOCH)
+        line.append(' ').append(measurement.timestamp);
+}
+
+bool post_to_influx_db(const char* payload, size_t length, uint32_t timeout_ms)
+{
+    if (WiFi.status() != WL_CONNECTED) {
+        LOG_ERROR("WiFi not connected");
+        return false;
+    }
+
+    unsigned long start = millis();
+    bool locked = xSemaphoreTake(connection_lock(), pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+    uint32_t waited_ms = millis() - start;
+    if (locked && waited_ms >= timeout_ms) {
+        xSemaphoreGive(connection_lock());
+        locked = false;
+    }
+    if (!locked) {
+        LOG_ERROR("InfluxDB connection busy with another write until the timeout.");
+        return false;
+    }
+    timeout_ms -= waited_ms;
+
+    LOG_INFO("Sending data to InfluxDB...");
+
+    http.setReuse(true);
+    http.begin(INFLUXDB_HOSTNAME "/api/v2/write?bucket=" INFLUXDB_BUCKET "&precision=s");
+    http.setConnectTimeout(timeout_ms);
+    http.setTimeout(timeout_ms);
+
+    http.addHeader("Authorization", "Token " INFLUXDB_API_TOKEN);
+    http.addHeader("Content-Type", "text/plain; charset=utf-8");
+    http.addHeader("Accept", "application/json");
+
+    // the field names repeat on every line, so multi-point payloads shrink to a third and less on air
+    bool compressed = false;
+    size_t compressed_length = 0;
+    if (length >= INFLUXDB_GZIP_MIN_BYTES) {
+        compressed_length = gzip_compress((const uint8_t*)payload, length, gzip_buffer, sizeof(gzip_buffer));
+        compressed = compressed_length > 0 && compressed_length < length;
+    }
+
+    int response_code;
+    if (compressed) {
+        LOG_INFO("Payload compressed from %u to %u bytes.", (unsigned int)length, (unsigned int)compressed_length);
+        http.addHeader("Content-Encoding", "gzip");
+        response_code = http.POST(gzip_buffer, compressed_length);
     } else {
-        serial_log("WiFi not connected");
+        response_code = http.POST((uint8_t*)payload, length);
+    }
+    LOG_DEBUG("%s", payload);
+
+    if (response_code > 0)
+        LOG_INFO("HTTP Response Code: %d", response_code);
+    else
+        LOG_ERROR("Error in HTTP request: %d", response_code);
+
+    wait_for(10);
+    http.end();
+    xSemaphoreGive(connection_lock());
+
+    // InfluxDB answers a successful write with 204 No Content
+    return response_code >= 200 && response_code < 300;
+}
+
+bool send_to_influx_db(const Measurement& measurement, uint32_t timeout_ms)
+{
+    // the point, the firmware_perf records of the cycles since the last upload and the sensor health map
+    static char buffer[INFLUXDB_LINE_MAX_LENGTH + 1 + PERF_HISTORY_SIZE * (PERF_LINE_MAX_LENGTH + 1) + 1
+        + SENSOR_HEALTH_LINE_MAX_LENGTH];
+    PayloadWriter payload(buffer, sizeof(buffer));
+    write_line_protocol(payload, measurement);
+    uint8_t perf_records = perf_write_history(payload);
+    sensor_write_health(payload);
+    if (payload.overflowed()) {
+        // InfluxDB would reject the whole write for the cut line, on every retry; the point goes to the outbox
+        LOG_ERROR("InfluxDB payload too long - not sending, dropping %u firmware_perf records.", perf_records);
+        perf_clear_history(perf_records);
+        return false;
     }
+    if (!post_to_influx_db(payload.c_str(), payload.length(), timeout_ms))
+        return false;
+    perf_clear_history(perf_records);
+    return true;
 }
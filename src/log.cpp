@@ -0,0 +1,191 @@
+#include "log.h"
+#include "collector.h"
+#include "env.h"
+#include "payload_writer.h"
+#include "wait.h"
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#if LOG_PERSIST_IN_RTC
+#define LOG_RING_ATTR RTC_DATA_ATTR
+#else
+#define LOG_RING_ATTR
+#endif
+
+/**
+ * Log lines, each terminated by a newline, stored contiguously modulo the
+ * buffer size starting at log_start
+ */
+LOG_RING_ATTR static char log_ring[LOG_BUFFER_SIZE];
+LOG_RING_ATTR static uint16_t log_start = 0;
+LOG_RING_ATTR static uint16_t log_used = 0;
+LOG_RING_ATTR static uint16_t log_dropped_lines = 0;
+
+static_assert(LOG_BUFFER_SIZE > LOG_LINE_MAX_LENGTH, "LOG_BUFFER_SIZE must hold at least one full line");
+static_assert(LOG_BUFFER_SIZE <= 65535, "LOG_BUFFER_SIZE must fit the 16-bit ring indices");
+
+/**
+ * Amount of log sent to the server per socket write
+ */
+#define LOG_SEND_CHUNK_SIZE 512
+
+/**
+ * UART transmit buffer with LOG_SERIAL_NON_BLOCKING, drained by the driver while
+ * the firmware goes on
+ */
+#define LOG_SERIAL_TX_BUFFER_SIZE 1024
+
+static uint16_t clear_ring();
+
+static SemaphoreHandle_t log_lock()
+{
+    // the SPS30 task logs concurrently with the main task
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    return lock;
+}
+
+/**
+ * Drops whole lines from the front of the ring until at least `needed` bytes are free
+ */
+static void make_room(size_t needed)
+{
+    while ((size_t)(LOG_BUFFER_SIZE - log_used) < needed && log_used > 0) {
+        while (log_used > 0) {
+            char dropped = log_ring[log_start];
+            log_start = (log_start + 1) % LOG_BUFFER_SIZE;
+            log_used--;
+            if (dropped == '\n')
+                break;
+        }
+        log_dropped_lines++;
+    }
+}
+
+static void ring_write(const char* data, size_t length)
+{
+    make_room(length);
+    for (size_t i = 0; i < length; i++)
+        log_ring[(log_start + log_used + i) % LOG_BUFFER_SIZE] = data[i];
+    log_used += length;
+}
+
+void log_begin()
+{
+    // created up front, so logging from the sensor path does not allocate
+    log_lock();
+#if LOG_SERIAL == LOG_SERIAL_NON_BLOCKING
+    Serial.setTxBufferSize(LOG_SERIAL_TX_BUFFER_SIZE);
+#endif
+#if LOG_SERIAL != LOG_SERIAL_OFF
+    Serial.begin(115200);
+#endif
+#if LOG_SERIAL == LOG_SERIAL_BLOCKING
+    // with USB CDC, until a terminal opens the port
+    while (!Serial) {
+        wait_for(20);
+    }
+#endif
+}
+
+void log_message(uint8_t level, const char* format, ...)
+{
+    // each line starts with the initial of its level, so a sent log can be filtered with grep
+    static const char level_initials[] = "?EWID";
+    char line[LOG_LINE_PREFIX_LENGTH + LOG_LINE_MAX_LENGTH + 1];
+    line[0] = level_initials[level < sizeof(level_initials) - 1 ? level : 0];
+    line[1] = ' ';
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line + LOG_LINE_PREFIX_LENGTH, sizeof(line) - LOG_LINE_PREFIX_LENGTH - 1, format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+    length += LOG_LINE_PREFIX_LENGTH;
+    if ((size_t)length > sizeof(line) - 2)
+        length = sizeof(line) - 2;
+    line[length++] = '\n';
+
+    xSemaphoreTake(log_lock(), portMAX_DELAY);
+    ring_write(line, length);
+#if LOG_SERIAL == LOG_SERIAL_BLOCKING
+    Serial.write(reinterpret_cast<const uint8_t*>(line), length);
+#elif LOG_SERIAL == LOG_SERIAL_NON_BLOCKING
+    if (Serial.availableForWrite() >= length)
+        Serial.write(reinterpret_cast<const uint8_t*>(line), length);
+#endif
+    xSemaphoreGive(log_lock());
+}
+
+size_t log_length() { return log_used; }
+
+void send_log()
+{
+    if (LOG_TO_COLLECTOR) {
+        xSemaphoreTake(log_lock(), portMAX_DELAY);
+        // the ring holds at most two contiguous runs: up to the end of the buffer, then from its start
+        size_t first_run = min((size_t)log_used, (size_t)(LOG_BUFFER_SIZE - log_start));
+        send_log_to_collector(log_ring + log_start, first_run);
+        send_log_to_collector(log_ring, log_used - first_run);
+        uint16_t dropped = clear_ring();
+        xSemaphoreGive(log_lock());
+
+        LOG_INFO("Log sent to the collector.");
+        if (dropped > 0)
+            LOG_WARN("%u log lines were dropped before sending (LOG_BUFFER_SIZE).", dropped);
+        return;
+    }
+
+    WiFiClient client;
+    if (client.connect(LOG_SERVER_HOST, LOG_SERVER_PORT)) {
+        xSemaphoreTake(log_lock(), portMAX_DELAY);
+
+        char header_buffer[192];
+        PayloadWriter header(header_buffer, sizeof(header_buffer));
+        header.append("POST " LOG_SERVER_PATH " HTTP/1.1\r\nHost: " LOG_SERVER_HOST "\r\n");
+        header.append("Content-Type: text/plain\r\nContent-Length: ").append((uint32_t)log_used);
+        header.append("\r\nConnection: close\r\n\r\n");
+        client.write(reinterpret_cast<const uint8_t*>(header.c_str()), header.length());
+
+        // the ring holds at most two contiguous runs: up to the end of the buffer, then from its start
+        size_t sent = 0;
+        while (sent < log_used) {
+            size_t offset = (log_start + sent) % LOG_BUFFER_SIZE;
+            size_t chunk = min((size_t)LOG_SEND_CHUNK_SIZE, min(log_used - sent, LOG_BUFFER_SIZE - offset));
+            client.write(reinterpret_cast<const uint8_t*>(log_ring + offset), chunk);
+            sent += chunk;
+        }
+
+        uint16_t dropped = clear_ring();
+        xSemaphoreGive(log_lock());
+
+        wait_for(10);
+        client.stop();
+
+        LOG_INFO("Log sent synchronously (no response expected).");
+        if (dropped > 0)
+            LOG_WARN("%u log lines were dropped before sending (LOG_BUFFER_SIZE).", dropped);
+    } else {
+        LOG_ERROR("Failed to connect to the log server.");
+    }
+}
+
+/**
+ * Empties the ring; the caller holds the lock
+ *
+ * @return Number of lines dropped since the last send
+ */
+static uint16_t clear_ring()
+{
+    uint16_t dropped = log_dropped_lines;
+    log_start = 0;
+    log_used = 0;
+    log_dropped_lines = 0;
+    return dropped;
+}
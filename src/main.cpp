@@ -5,34 +5,125 @@
 #include <SensirionI2cSps30.h>
 #include <WiFi.h>
 #include <Wire.h>
-#include <memory>
 
+#include "batch.h"
+#include "clock.h"
+#include "collector.h"
+#include "deadband.h"
 #include "env.h"
 #include "influxdb.h"
 #include "measurement.h"
+#include "outbox.h"
+#include "perf.h"
+#include "power.h"
+#include "schedule.h"
+#include "uploader.h"
 #include "utils.h"
+#include "wait.h"
 #include "wunderground.h"
 
 #define MOSFET_PIN 13
 
+/**
+ * Rather than keeping the radio on while waiting longer than this for the SPS30,
+ * switch it off and reconnect afterwards (fast, with the cached access point)
+ */
+#define WIFI_MAX_IDLE_MS 5000
+
+static bool wunderground_sink(void* measurement, uint32_t timeout_ms)
+{
+    perf_begin(PERF_WUNDERGROUND);
+    bool sent = send_to_wunderground(*static_cast<const Measurement*>(measurement), timeout_ms);
+    perf_end(PERF_WUNDERGROUND);
+    return sent;
+}
+
+/**
+ * Progress of the InfluxDB upload of a single point
+ */
+enum InfluxDbDelivery : uint8_t {
+    INFLUX_DB_NOT_STARTED,
+    INFLUX_DB_PENDING, // still running when abandoned at the deadline: the write may have arrived
+    INFLUX_DB_DELIVERED,
+    INFLUX_DB_FAILED,
+};
+
+/**
+ * Set by the InfluxDB upload of a single point; only a point that certainly did
+ * not arrive goes to the outbox, as InfluxDB would store it twice otherwise
+ */
+static volatile InfluxDbDelivery influx_db_delivery = INFLUX_DB_NOT_STARTED;
+
+static bool influx_db_sink(void* measurement, uint32_t timeout_ms)
+{
+    perf_begin(PERF_INFLUXDB);
+    bool sent = send_to_influx_db(*static_cast<const Measurement*>(measurement), timeout_ms);
+    perf_end(PERF_INFLUXDB);
+    influx_db_delivery = sent ? INFLUX_DB_DELIVERED : INFLUX_DB_FAILED;
+    return sent;
+}
+
+static bool influx_db_batch_sink(void*, uint32_t timeout_ms)
+{
+    perf_begin(PERF_INFLUXDB);
+    bool sent = batch_flush(timeout_ms);
+    perf_end(PERF_INFLUXDB);
+    return sent;
+}
+
+static bool collector_sink(void* measurement, uint32_t timeout_ms)
+{
+    perf_begin(PERF_COLLECTOR);
+    bool sent = send_to_collector(*static_cast<const Measurement*>(measurement), timeout_ms);
+    perf_end(PERF_COLLECTOR);
+    return sent;
+}
+
+static bool outbox_sink(void*, uint32_t timeout_ms)
+{
+    perf_begin(PERF_OUTBOX);
+    bool drained = outbox_drain(timeout_ms);
+    perf_end(PERF_OUTBOX);
+    return drained;
+}
+
+static bool timed_connect_to_wifi()
+{
+    perf_begin(PERF_WIFI_CONNECT);
+    bool connected = connect_to_wifi();
+    perf_end(PERF_WIFI_CONNECT);
+    return connected;
+}
+
+/**
+ * Cleared at power-on only: what survives deep sleep is set up once
+ */
+RTC_DATA_ATTR bool one_time_setup_done = false;
+
 void setup()
 {
+    perf_start_cycle();
     unsigned long startTime = millis();
 
+    /**
+     * Nothing but the sensor power, power management and the log come before
+     * the sensors: with LOG_SERIAL_NON_BLOCKING or LOG_SERIAL_OFF, the wake does
+     * not wait for a terminal or the UART. The ADC of the chip is not set up, as
+     * the ADS1115 measures all voltages.
+     */
 #ifdef ENV_ESP32DEV
-	btStop();
+    // once stopped, the Bluetooth controller stays off through deep sleep
+    if (!one_time_setup_done)
+        btStop();
 
     pinMode(MOSFET_PIN, OUTPUT);
     digitalWrite(MOSFET_PIN, HIGH);
-
-    analogReadResolution(12);
-    analogSetAttenuation(ADC_11db);
 #endif
+    one_time_setup_done = true;
 
-    Serial.begin(115200);
-    while (!Serial) {
-        delay(20);
-    }
+    log_begin();
+    wait_begin();
+    clock_wake();
 
 #ifdef ENV_ESP32DEV
 	Wire.begin(21, 22);
@@ -40,6 +131,8 @@ void setup()
 #ifdef ENV_ESP32C3_SUPER_MINI
 	Wire.begin(8, 9);
 #endif
+    // Wire.begin() does not touch the bus; the sensors are addressed right away
+    perf_mark(PERF_FIRST_I2C);
 
     Adafruit_ADS1115 ads_sensor; // ADS1115: measures analog inputs
     Adafruit_AHTX0 aht_sensor; // AHT20: measures temperature and humidity
@@ -48,42 +141,154 @@ void setup()
 	SensirionI2cSps30 sps30_sensor; // SPS30: measures particulate matter
     Measurement measurement; // holds all sensor data
 
+    // the tier chosen at the end of the previous cycle decides on the SPS30, with the schedule of each sensor
+    PowerPlan plan = power_plan();
+    schedule_begin_cycle(plan);
+
+    // runs in the background while the other sensors are read and the data is sent
+    measurement.start_particulate_matter_reading(sps30_sensor);
+
     measurement.read_sensors_and_voltage(
 		bmp_sensor,
 		aht_sensor,
 		light_meter,
-		ads_sensor,
-		sps30_sensor
+		ads_sensor
 	);
     measurement.remove_invalid_measurements();
     measurement.calculate_derived_values();
+    measurement.remove_invalid_measurements();
+
+    power_update(measurement);
+    plan = power_plan();
+    schedule_update(measurement);
+
+    /**
+     * Only measurements that moved beyond the deadbands are reported; in stable
+     * conditions most cycles keep the WiFi off. A running SPS30 measurement is
+     * always reported, as it only comes every few cycles.
+     */
+    bool report = deadband_exceeded(measurement) || measurement.particulate_matter_in_progress();
+
+    /**
+     * With batching enabled, the measurement goes to the RTC buffer first and
+     * the WiFi is only brought up on the cycles that upload the buffer.
+     * The point of this cycle is only added once the SPS30 is done, so it is
+     * counted in up front. Points left over from a power-saving tier keep
+     * batching on until they are uploaded.
+     * Points kept in the outbox during an outage are uploaded on the next
+     * cycle that gets a connection. After failed connects, cycles are skipped
+     * with an exponential backoff.
+     */
+    bool batching = plan.batch_cycles > 1 || batch_count() > 0;
+    bool wifi_allowed = wifi_backoff_elapsed();
+    bool upload = plan.radio && wifi_allowed
+        && ((batching ? batch_flush_due(plan.batch_cycles, report) : report) || (OUTBOX_ENABLED && outbox_count() > 0));
+
+    /**
+     * Uploads run concurrently, each in its own task, and have to be done within
+     * UPLOAD_BUDGET_MS of the connection, so a slow service cannot keep the radio
+     * on much longer than the others.
+     * Weather Underground gets no particulate matter, so it does not have to
+     * wait for the SPS30. It gets its own copy of the measurement, which the
+     * main task keeps updating.
+     * SNTP only runs on the few wakes it is due (clock.h); a measurement taken
+     * before the first synchronization gets its timestamp fixed up.
+     */
+    Measurement wunderground_measurement;
+    unsigned long upload_deadline = 0;
+    bool online = upload && timed_connect_to_wifi();
+    if (online) {
+        upload_deadline = millis() + UPLOAD_BUDGET_MS;
+        if (clock_sync_due()) {
+            perf_begin(PERF_CLOCK_SYNC);
+            synchronize_clock(UPLOAD_BUDGET_MS);
+            perf_end(PERF_CLOCK_SYNC);
+        }
+        if (measurement.timestamp < VALID_EPOCH && clock_offset() != 0)
+            measurement.timestamp += clock_offset();
+        wunderground_measurement = measurement;
+        if (SEND_TO_EXTERNAL_SERVICES && report && measurement.has_sensor_data())
+            upload_start("wunderground", wunderground_sink, &wunderground_measurement, upload_deadline);
+        if (measurement.particulate_matter_pending_ms() > WIFI_MAX_IDLE_MS) {
+            upload_wait(upload_deadline);
+            WiFi.mode(WIFI_OFF);
+        }
+    }
+
+    measurement.finish_particulate_matter_reading();
+    measurement.remove_invalid_measurements();
     measurement.print_all_values();
 
-    unsigned long activeTime = (millis() - startTime) / 1000;
+    if (report) {
+        deadband_reported(measurement);
+        if (batching && measurement.has_sensor_data())
+            batch_add(measurement);
+    } else {
+        deadband_skipped();
+        LOG_INFO("No value changed beyond its deadband - not reporting this cycle.");
+    }
 
-	connect_to_wifi();
-    if (SEND_TO_EXTERNAL_SERVICES) {
-        if (measurement.has_sensor_data()) {
-            send_to_wunderground(measurement);
-            send_to_influx_db(measurement);
+    if (online && WiFi.status() != WL_CONNECTED) {
+        online = timed_connect_to_wifi();
+        upload_deadline = millis() + UPLOAD_BUDGET_MS;
+    }
+    if (online) {
+        if (SEND_TO_EXTERNAL_SERVICES) {
+            if (!measurement.has_sensor_data())
+                LOG_WARN("No sensor data available - skipping external services.");
+            else if (!batching && report) {
+                // set before the task can finish
+                influx_db_delivery = INFLUX_DB_PENDING;
+                if (!upload_start("influxdb", influx_db_sink, &measurement, upload_deadline))
+                    influx_db_delivery = INFLUX_DB_NOT_STARTED;
+            }
+            if (batching)
+                upload_start("influxdb", influx_db_batch_sink, nullptr, upload_deadline);
+            // the collector gets the points of reported cycles that have the radio on; batched ones go to InfluxDB only
+            if (SEND_TO_COLLECTOR && report && measurement.has_sensor_data())
+                upload_start("collector", collector_sink, &measurement, upload_deadline);
+            if (OUTBOX_ENABLED && outbox_count() > 0)
+                upload_start("outbox", outbox_sink, nullptr, upload_deadline);
         } else {
-            serial_log("No sensor data available - skipping external services.");
+            LOG_INFO("External services sending is disabled.");
         }
+        upload_wait(upload_deadline);
+
+        perf_begin(PERF_SEND_LOG);
+        send_log();
+        perf_end(PERF_SEND_LOG);
+    } else if (upload) {
+        LOG_WARN("No WiFi - %u points buffered, %u in the outbox.", batch_count(), OUTBOX_ENABLED ? outbox_count() : 0);
+    } else if (!wifi_allowed) {
+        LOG_INFO("WiFi backoff - not trying to connect this cycle.");
+    } else if (!plan.radio) {
+        LOG_WARN("Battery critical - buffered %u points, WiFi stays off.", batch_count());
     } else {
-        serial_log("External services sending is disabled.");
+        LOG_INFO("Buffered %u of %u points - WiFi stays off this cycle.", batch_count(), plan.batch_cycles);
     }
 
-    send_log();
+    // a single point that did not reach InfluxDB waits in flash for the next connection
+    if (OUTBOX_ENABLED && SEND_TO_EXTERNAL_SERVICES && report && !batching && measurement.has_sensor_data()) {
+        if (influx_db_delivery == INFLUX_DB_NOT_STARTED || influx_db_delivery == INFLUX_DB_FAILED)
+            outbox_add(measurement);
+        else if (influx_db_delivery == INFLUX_DB_PENDING)
+            LOG_WARN("InfluxDB upload abandoned - the point may have arrived, not adding it to the outbox.");
+    }
 
     // digitalWrite(MOSFET_PIN, LOW);
     isolate_all_rtc_gpio();
     WiFi.mode(WIFI_OFF);
 
-    unsigned long sleepTime = (activeTime < CYCLE_TIME_SEC) ? ((CYCLE_TIME_SEC - activeTime))
-                                                            : (CYCLE_TIME_SEC); // ensure we don't get huge sleep times
-    serial_log("Entering deep sleep for " + String(sleepTime) + " seconds...");
+    unsigned long activeTime = (millis() - startTime) / 1000;
+    unsigned long sleepTime = (activeTime < plan.cycle_time_s) ? ((plan.cycle_time_s - activeTime))
+                                                               : (plan.cycle_time_s); // ensure we don't get huge sleep times
+    LOG_INFO("Entering deep sleep for %lu seconds...", sleepTime);
+    perf_finish_cycle();
 
-    esp_sleep_enable_timer_wakeup(sleepTime * 1000000); // convert to microseconds
+    // unsigned long is 32 bits on the ESP32: the microseconds of a cycle over 71 minutes would wrap
+    uint64_t sleep_us = (uint64_t)sleepTime * 1000000;
+    clock_sleep(sleep_us);
+    esp_sleep_enable_timer_wakeup(sleep_us);
     esp_deep_sleep_start();
 }
 
@@ -1,9 +1,19 @@
+#include <limits.h>
 #include <math.h>
+#include <time.h>
 #include <Wire.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
 #include "env.h"
 #include "measurement.h"
+#include "perf.h"
+#include "schedule.h"
+#include "sensor_health.h"
 #include "utils.h"
+#include "wait.h"
 
 #ifdef NO_ERROR
 #undef NO_ERROR
@@ -11,53 +21,123 @@
 #define NO_ERROR 0
 
 /**
- * SPS30 sensor seems to be power-hungry and needs a long startup time,
- * so we only want to measure with it every N cycles.
- * We use RTC_DATA_ATTR to retain the cycle count across deep sleep cycles,
- * so we can keep track of when to measure with the SPS30 sensor again.
- *
- * https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-guides/deep-sleep-stub.html#load-wake-stub-data-into-rtc-memory
+ * The SPS30 needs its fan running for tens of seconds before and during sampling,
+ * so it is read by a background task while the other sensors and the network are
+ * handled. The task stores the averages in sps30_result and gives sps30_done.
  */
-RTC_DATA_ATTR uint8_t cycles_since_sps30 = SPS30_MEASUREMENT_INTERVAL_CYCLES;
+static SemaphoreHandle_t sps30_done = nullptr;
+static Measurement sps30_result;
+static unsigned long sps30_expected_end_ms = 0;
+
+static_assert(SPS30_MIN_READINGS >= 2 && SPS30_MIN_READINGS <= SPS30_NUM_READINGS && SPS30_NUM_READINGS <= 255,
+    "SPS30_MIN_READINGS must be at least 2 and at most SPS30_NUM_READINGS, which fits a uint8_t");
 
 /**
- * SPS30 sensor needs to be cleaned every N cycles to maintain accuracy,
- * so we also keep track of cycles since last cleaning in RTC memory.
+ * Upper bound on the SPS30 task run time, after which we stop waiting for it
  */
-RTC_DATA_ATTR uint16_t cycles_since_sps30_cleaning = SPS30_CLEANING_INTERVAL_CYCLES;
+#define SPS30_TASK_TIMEOUT_S (SPS30_CLEANING_TIME_S + SPS30_STARTUP_TIME_S + SPS30_NUM_READINGS * SPS30_SAMPLING_INTERVAL_S + 10)
+
+/**
+ * Running mean and variance of a series of samples (Welford's algorithm)
+ */
+struct RunningStats {
+    uint8_t count = 0;
+    float mean = 0;
+    float m2 = 0; // sum of squared deviations from the mean
+
+    void add(float value)
+    {
+        count++;
+        float delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    /**
+     * Half-width of the 95% confidence interval of the mean (Student's t)
+     */
+    float confidence_half_width() const
+    {
+        if (count < 2)
+            return INFINITY;
+        // two-sided 95% quantiles for 1..10 degrees of freedom; beyond, 1.96 + 2.4 / df is within 0.5%
+        static const float t_95[] = { 12.71f, 4.30f, 3.18f, 2.78f, 2.57f, 2.45f, 2.36f, 2.31f, 2.26f, 2.23f };
+        uint8_t degrees = count - 1;
+        float t = degrees <= 10 ? t_95[degrees - 1] : 1.96f + 2.4f / degrees;
+        return t * sqrtf(m2 / degrees / count);
+    }
+};
+
+/**
+ * Datasheet maximum conversion times of the triggered I2C sensor readings
+ */
+#define BH1750_CONVERSION_MS 180 // one-time high resolution mode
+#define ADS1115_CONVERSION_MS 9 // single shot at 128 SPS: 7.8 ms, plus the oscillator's 10% tolerance
+
+/**
+ * A triggered sensor conversion, whose result can be read once its conversion time is up
+ */
+struct Conversion {
+    bool pending = false;
+    unsigned long started_ms = 0;
+    unsigned long duration_ms = 0;
+
+    void start(unsigned long duration)
+    {
+        pending = true;
+        started_ms = millis();
+        // millis() may tick right after the trigger, so one more to be sure the full time has passed
+        duration_ms = duration + 1;
+    }
+
+    unsigned long left_ms() const
+    {
+        unsigned long elapsed = millis() - started_ms;
+        return elapsed >= duration_ms ? 0 : duration_ms - elapsed;
+    }
+
+    bool done() const { return pending && left_ms() == 0; }
+};
+
+/**
+ * ADS1115 inputs, converted one after the other by its single ADC
+ */
+struct Ads1115Channel {
+    uint16_t mux;
+    adsGain_t gain;
+};
+
+static const Ads1115Channel ads1115_channels[] = {
+    { ADS1X15_REG_CONFIG_MUX_SINGLE_0, GAIN_ONE }, // battery voltage, +/-4.096V range
+    { ADS1X15_REG_CONFIG_MUX_SINGLE_1, GAIN_ONE }, // solar panel voltage
+    { ADS1X15_REG_CONFIG_MUX_SINGLE_2, GAIN_FOUR }, // UV sensor voltage, +/-1.024V range
+};
+
+#define ADS1115_CHANNEL_COUNT (sizeof(ads1115_channels) / sizeof(ads1115_channels[0]))
 
 static float calculate_dew_point(float temperature, float humidity);
+static void start_ads1115_conversion(Adafruit_ADS1115& ads_sensor, uint8_t index, Conversion& conversion);
+static float median(float* values, uint8_t count);
 static bool read_sps30_data(SensirionI2cSps30& sps30_sensor, Measurement& measurement);
+static void sps30_task(void* sps30_sensor);
 
-Measurement::Measurement()
-    : temperature_c(nullptr)
-    , temperature_f(nullptr)
-    , humidity(nullptr)
-    , pressure_hpa(nullptr)
-    , pressure_b(nullptr)
-    , dew_point_c(nullptr)
-    , dew_point_f(nullptr)
-    , illumination(nullptr)
-    , battery_voltage_a0(nullptr)
-    , solar_panel_voltage_a1(nullptr)
-    , uv_voltage_a2(nullptr)
-    , uv_index(nullptr)
-	, mc_pm1_0(nullptr)
-	, mc_pm2_5(nullptr)
-	, mc_pm10_0(nullptr)
-{
-}
-
-void Measurement::read_sensors_and_voltage(
-    Adafruit_BMP280& bmp_sensor,
-    Adafruit_AHTX0& aht_sensor,
-    BH1750& light_meter,
-    Adafruit_ADS1115& ads_sensor,
-    SensirionI2cSps30& sps30_sensor)
+void Measurement::start_particulate_matter_reading(SensirionI2cSps30& sps30_sensor)
 {
-	if (cycles_since_sps30 >= SPS30_MEASUREMENT_INTERVAL_CYCLES) {
-		if (!read_sps30_data(sps30_sensor, *this))
-			serial_log("Failed to read SPS30 data.");
+	// the SPS30 is power-hungry and needs a long startup time, so it only runs every few cycles (schedule.h)
+	if (schedule_due(JOB_SPS30)) {
+		sps30_expected_end_ms = millis() + (SPS30_STARTUP_TIME_S + SPS30_NUM_READINGS * SPS30_SAMPLING_INTERVAL_S) * 1000;
+		if (schedule_due(JOB_SPS30_CLEANING))
+			sps30_expected_end_ms += SPS30_CLEANING_TIME_S * 1000;
+
+		// a missing SPS30 is tried on fewer and fewer of its scheduled cycles (sensor_health.h)
+		if (sensor_probe_due(SENSOR_SPS30)) {
+			sps30_done = xSemaphoreCreateBinary();
+			if (xTaskCreate(sps30_task, "sps30", 4096, &sps30_sensor, 1, nullptr) != pdPASS) {
+				LOG_ERROR("SPS30: could not start the measurement task.");
+				vSemaphoreDelete(sps30_done);
+				sps30_done = nullptr;
+			}
+		}
 		/**
 		 * We actually want to update the count regardless of whether we
 		 * successfully read from the sensor or not, because even if the
@@ -65,146 +145,213 @@ void Measurement::read_sensors_and_voltage(
 		 * next attempt to read from the sensor, to avoid draining the battery
 		 * with repeated failed attempts.
 		 */
-		cycles_since_sps30 = 0;
+		schedule_done(JOB_SPS30);
 	} else {
-		cycles_since_sps30++;
-		serial_log("SPS30: skipping this cycle (scheduled interval).");
+		LOG_INFO("SPS30: skipping this cycle (scheduled interval).");
 	}
+}
 
-    if (bmp_sensor.begin(0x77))
-        pressure_hpa = std::make_unique<float>(bmp_sensor.readPressure() / 100.0); // Pa to hPa conversion
-    else
-        serial_log("Could not find BMP280!");
+bool Measurement::particulate_matter_in_progress() const { return sps30_done != nullptr; }
 
-    if (aht_sensor.begin()) {
-        sensors_event_t hum, temp;
-        aht_sensor.getEvent(&hum, &temp);
-        temperature_c = std::make_unique<float>(temp.temperature);
-        humidity = std::make_unique<float>(hum.relative_humidity);
-    } else
-        serial_log("Could not find AHT20!");
+unsigned long Measurement::particulate_matter_pending_ms() const
+{
+    if (sps30_done == nullptr)
+        return 0;
+    long left = (long)(sps30_expected_end_ms - millis());
+    return left > 0 ? left : 0;
+}
+
+void Measurement::finish_particulate_matter_reading()
+{
+    if (sps30_done == nullptr)
+        return;
+
+    if (xSemaphoreTake(sps30_done, pdMS_TO_TICKS(SPS30_TASK_TIMEOUT_S * 1000)) != pdTRUE) {
+        LOG_ERROR("SPS30: measurement task did not finish in time.");
+        return; // the task keeps the semaphore and the result; deep sleep ends it
+    }
+    vSemaphoreDelete(sps30_done);
+    sps30_done = nullptr;
+
+    for (Field field : { MC_PM1_0, MC_PM2_5, MC_PM10_0 })
+        if (sps30_result.has(field))
+            set(field, sps30_result.get(field));
+}
 
-    if (light_meter.begin()) {
-        delay(200);  // important
-        illumination = std::make_unique<float>(light_meter.readLightLevel());
+void Measurement::read_sensors_and_voltage(
+    Adafruit_BMP280& bmp_sensor,
+    Adafruit_AHTX0& aht_sensor,
+    BH1750& light_meter,
+    Adafruit_ADS1115& ads_sensor)
+{
+    /**
+     * The chips convert at the same time: each conversion is triggered as soon
+     * as its sensor is found, the slowest (BH1750) first, and collected once its
+     * datasheet conversion time is up, so the whole phase takes about as long as
+     * the BH1750 alone rather than the sum of all conversions. The AHT20 driver
+     * triggers, waits and reads in one call, which runs while the others convert.
+     * So does the BMP280 driver's begin(), which waits 100 ms after the chip's
+     * reset; the calibration it reads on the way is private to the driver.
+     */
+    Conversion light_conversion, ads_conversion;
+    uint8_t ads_channel = 0;
+    float ads_volts[ADS1115_CHANNEL_COUNT];
+    timestamp = time(nullptr);
+
+    // sensors not due this cycle (schedule.h) are left alone; the UV channel is the last one converted
+    uint8_t ads_channel_count = schedule_due(JOB_UV) ? ADS1115_CHANNEL_COUNT : ADS1115_CHANNEL_COUNT - 1;
+
+    // sensors missing in earlier cycles are only probed now and then (sensor_health.h)
+    if (schedule_due(JOB_BH1750)) {
+        schedule_done(JOB_BH1750);
+        perf_begin(PERF_BH1750_BEGIN);
+        // in one-time mode, begin() starts the conversion, after which the chip powers down
+        bool light_found = sensor_begin(
+            SENSOR_BH1750, [&](uint8_t address) { return light_meter.begin(BH1750::ONE_TIME_HIGH_RES_MODE, address); });
+        perf_end(PERF_BH1750_BEGIN);
+        if (light_found) {
+            perf_begin(PERF_BH1750_READ);
+            light_conversion.start(BH1750_CONVERSION_MS);
+        } else
+            LOG_ERROR("Could not find BH1750!");
+    }
+
+    if (schedule_due(JOB_BMP280)) {
+        schedule_done(JOB_BMP280);
+        perf_begin(PERF_BMP280_BEGIN);
+        bool bmp_found = sensor_begin(SENSOR_BMP280, [&](uint8_t address) { return bmp_sensor.begin(address); });
+        perf_end(PERF_BMP280_BEGIN);
+        if (bmp_found) {
+            perf_begin(PERF_BMP280_READ);
+            // begin() leaves the chip in normal mode, pressure x16, and its wait outlasts the first
+            // conversion (75.5 ms at most): read that one, then the chip sleeps until the next cycle
+            set(PRESSURE_HPA, bmp_sensor.readPressure() / 100.0); // Pa to hPa conversion
+            bmp_sensor.setSampling(Adafruit_BMP280::MODE_SLEEP);
+            perf_end(PERF_BMP280_READ);
+        } else
+            LOG_ERROR("Could not find BMP280!");
+    }
+
+    perf_begin(PERF_ADS1115_BEGIN);
+    bool ads_found = sensor_begin(SENSOR_ADS1115, [&](uint8_t address) { return ads_sensor.begin(address); });
+    perf_end(PERF_ADS1115_BEGIN);
+    if (ads_found) {
+        perf_begin(PERF_ADS1115_READ);
+        start_ads1115_conversion(ads_sensor, ads_channel, ads_conversion);
     } else
-        serial_log("Could not find BH1750!");
-
-    if (ads_sensor.begin()) {
-        // GAIN_ONE: +/-4.096V range (for battery and solar panel voltage)
-        ads_sensor.setGain(GAIN_ONE);
-
-        int16_t adc0 = ads_sensor.readADC_SingleEnded(0);
-        int16_t adc1 = ads_sensor.readADC_SingleEnded(1);
-        float voltage0 = ads_sensor.computeVolts(adc0);
-        float voltage1 = ads_sensor.computeVolts(adc1);
-
-        // GAIN_FOUR: +/-1.024V range (for UV sensor voltage)
-        ads_sensor.setGain(GAIN_FOUR);
-
-        int16_t adc2 = ads_sensor.readADC_SingleEnded(2);
-        float voltage2 = ads_sensor.computeVolts(adc2);
-
-        // When there's no signal or very weak signal,
-        // ADCs can return small negative values like -0.0, -0.001, etc.
-        float corrected_voltage0 = max(0.0f, voltage0);
-        float corrected_voltage1 = max(0.0f, voltage1);
-        float corrected_voltage2 = max(0.0f, voltage2);
-
-        battery_voltage_a0 = std::make_unique<float>((corrected_voltage0 * 1.33) + 0.03); // +0.03V calibration offset
-        solar_panel_voltage_a1 = std::make_unique<float>(corrected_voltage1 * 2.43);
-        uv_voltage_a2 = std::make_unique<float>(corrected_voltage2);
-    } else {
-        serial_log("Could not find ADS1115!");
+        LOG_ERROR("Could not find ADS1115!");
+
+    if (schedule_due(JOB_AHT20)) {
+        schedule_done(JOB_AHT20);
+        perf_begin(PERF_AHT20_BEGIN);
+        bool aht_found = sensor_begin(SENSOR_AHT20, [&](uint8_t address) { return aht_sensor.begin(&Wire, 0, address); });
+        perf_end(PERF_AHT20_BEGIN);
+        if (aht_found) {
+            perf_begin(PERF_AHT20_READ);
+            sensors_event_t hum, temp;
+            aht_sensor.getEvent(&hum, &temp);
+            set(TEMPERATURE_C, temp.temperature);
+            set(HUMIDITY, hum.relative_humidity);
+            perf_end(PERF_AHT20_READ);
+        } else
+            LOG_ERROR("Could not find AHT20!");
     }
+
+    while (light_conversion.pending || ads_conversion.pending) {
+        if (ads_conversion.done()) {
+            // When there's no signal or very weak signal,
+            // ADCs can return small negative values like -0.0, -0.001, etc.
+            ads_volts[ads_channel] = max(0.0f, ads_sensor.computeVolts(ads_sensor.getLastConversionResults()));
+            if (++ads_channel < ads_channel_count)
+                start_ads1115_conversion(ads_sensor, ads_channel, ads_conversion);
+            else {
+                ads_conversion.pending = false;
+                set(BATTERY_VOLTAGE_A0, (ads_volts[0] * 1.33) + 0.03); // +0.03V calibration offset
+                set(SOLAR_PANEL_VOLTAGE_A1, ads_volts[1] * 2.43);
+                if (ads_channel_count == ADS1115_CHANNEL_COUNT) {
+                    set(UV_VOLTAGE_A2, ads_volts[2]);
+                    schedule_done(JOB_UV);
+                }
+                perf_end(PERF_ADS1115_READ);
+            }
+        }
+
+        if (light_conversion.done()) {
+            light_conversion.pending = false;
+            set(ILLUMINATION, light_meter.readLightLevel());
+            perf_end(PERF_BH1750_READ);
+        }
+
+        // until the next conversion is done
+        unsigned long wait_ms = ULONG_MAX;
+        for (const Conversion* conversion : { &light_conversion, &ads_conversion })
+            if (conversion->pending)
+                wait_ms = min(wait_ms, conversion->left_ms());
+        if (wait_ms > 0 && wait_ms != ULONG_MAX)
+            wait_for(wait_ms);
+    }
+}
+
+/**
+ * Starts the single-shot conversion of ADS1115 channel `index`, at its gain
+ */
+static void start_ads1115_conversion(Adafruit_ADS1115& ads_sensor, uint8_t index, Conversion& conversion)
+{
+    ads_sensor.setGain(ads1115_channels[index].gain);
+    ads_sensor.startADCReading(ads1115_channels[index].mux, false);
+    conversion.start(ADS1115_CONVERSION_MS);
 }
 
 void Measurement::remove_invalid_measurements()
 {
-    /*
-        BMP280 (pressure):
-            https://www.alldatasheet.com/datasheet-pdf/view/1132069/BOSCH/BMP280.html
-        AHT20 (temperature and humidity):
-            https://static.maritex.eu/file/display/RNvX5GenZti93oVcmXPk9n_PKbFzX2F0/AHT20.pdf
-        BH1750 (illumination):
-            https://www.handsontec.com/dataspecs/sensor/BH1750%20Light%20Sensor.pdf
-		SPS30 (particulate matter):
-			https://sensirion.com/media/documents/8600FF88/64A3B8D6/Sensirion_PM_Sensors_Datasheet_SPS30.pdf
-    */
-    if (temperature_c)
-        if (*temperature_c < -40 || *temperature_c > 85)
-            temperature_c = nullptr;
-    if (humidity)
-        if (*humidity < 0 || *humidity > 100)
-            humidity = nullptr;
-    if (pressure_hpa)
-        if (*pressure_hpa < 300 || *pressure_hpa > 1100)
-            pressure_hpa = nullptr;
-    if (illumination)
-        if (*illumination < 0 || *illumination > 65535)
-            illumination = nullptr;
-    if (mc_pm1_0)
-        if (*mc_pm1_0 > 1000)
-            mc_pm1_0 = nullptr;
-    if (mc_pm2_5)
-        if (*mc_pm2_5 > 1000)
-            mc_pm2_5 = nullptr;
-    if (mc_pm10_0)
-        if (*mc_pm10_0 > 1000)
-            mc_pm10_0 = nullptr;
+    // valid ranges are those of the sensors' datasheets, linked in fields.h; NaN compares false to any limit,
+    // and a derived value can be NaN or infinite (the dew point at 0 % humidity), which InfluxDB would reject
+    for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+        Field field = (Field)i;
+        float value = get(field);
+        if (has(field) && (!isfinite(value) || value < field_descriptors[i].min || value > field_descriptors[i].max))
+            clear(field);
+    }
 }
 
 void Measurement::calculate_derived_values()
 {
-    if (temperature_c) {
-        temperature_f = std::make_unique<float>(*temperature_c * 9.0f / 5.0f + 32.0f);
-        if (humidity) {
-            dew_point_c = std::make_unique<float>(calculate_dew_point(*temperature_c, *humidity));
-            dew_point_f = std::make_unique<float>(*dew_point_c * 9.0f / 5.0f + 32.0f);
+    if (has(TEMPERATURE_C)) {
+        set(TEMPERATURE_F, get(TEMPERATURE_C) * 9.0f / 5.0f + 32.0f);
+        if (has(HUMIDITY)) {
+            set(DEW_POINT_C, calculate_dew_point(get(TEMPERATURE_C), get(HUMIDITY)));
+            set(DEW_POINT_F, get(DEW_POINT_C) * 9.0f / 5.0f + 32.0f);
         }
     }
-    if (pressure_hpa) {
-        pressure_b = std::make_unique<float>(*pressure_hpa * 0.02953f);
+    if (has(PRESSURE_HPA)) {
+        set(PRESSURE_B, get(PRESSURE_HPA) * 0.02953f);
     }
-    if (uv_voltage_a2) {
-        float calculated_uv_index = (*uv_voltage_a2) * 10.0;
+    if (has(UV_VOLTAGE_A2)) {
+        float calculated_uv_index = get(UV_VOLTAGE_A2) * 10.0;
         calculated_uv_index = max(0.0f, min(calculated_uv_index, 12.0f));
-        uv_index = std::make_unique<int>(round(calculated_uv_index));
+        set(UV_INDEX, round(calculated_uv_index));
     }
 }
 
 bool Measurement::has_sensor_data() const
 {
     // we generally don't want to send data if we don't have at least one sensor reading
-    return temperature_c != nullptr || humidity != nullptr || pressure_hpa != nullptr || illumination != nullptr || mc_pm2_5 != nullptr;
+    return has(TEMPERATURE_C) || has(HUMIDITY) || has(PRESSURE_HPA) || has(ILLUMINATION) || has(MC_PM2_5);
 }
 
 void Measurement::print_all_values() const
 {
-    if (temperature_c)
-        serial_log("Temperature: " + String(*temperature_c, 2) + " °C (" + String(*temperature_f, 2) + " °F)");
-    if (humidity)
-        serial_log("Humidity: " + String(*humidity, 1) + " %");
-    if (pressure_hpa)
-        serial_log("Pressure: " + String(*pressure_hpa, 2) + " hPa (" + String(*pressure_b, 2) + " inHg)");
-    if (dew_point_c)
-        serial_log("Dew Point: " + String(*dew_point_c, 2) + " °C (" + String(*dew_point_f, 2) + " °F)");
-    if (illumination)
-        serial_log("Illumination: " + String(*illumination, 1) + " lx");
-    if (battery_voltage_a0)
-        serial_log("Battery voltage: " + String(*battery_voltage_a0, 2) + " V");
-    if (solar_panel_voltage_a1)
-        serial_log("Solar panel voltage: " + String(*solar_panel_voltage_a1, 2) + " V");
-    if (uv_voltage_a2)
-        serial_log("UV voltage: " + String(*uv_voltage_a2, 2) + " V");
-    if (uv_index)
-        serial_log("UV Index: " + String(*uv_index));
-    if (mc_pm1_0)
-        serial_log("MC PM1.0: " + String(*mc_pm1_0, 2) + " ug/m3");
-    if (mc_pm2_5)
-        serial_log("MC PM2.5: " + String(*mc_pm2_5, 2) + " ug/m3");
-    if (mc_pm10_0)
-        serial_log("MC PM10.0: " + String(*mc_pm10_0, 2) + " ug/m3");
+    for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+        const FieldDescriptor& descriptor = field_descriptors[i];
+        if (descriptor.label == nullptr || !has((Field)i))
+            continue;
+        uint8_t alternate = descriptor.alternate;
+        if (alternate != FIELD_NO_ALTERNATE && has((Field)alternate))
+            LOG_INFO("%s: %.*f %s (%.*f %s)", descriptor.label, descriptor.decimals, get((Field)i), descriptor.unit,
+                field_descriptors[alternate].decimals, get((Field)alternate), field_descriptors[alternate].unit);
+        else
+            LOG_INFO("%s: %.*f %s", descriptor.label, descriptor.decimals, get((Field)i), descriptor.unit);
+    }
 }
 
 /**
@@ -228,75 +375,103 @@ static float calculate_dew_point(float temperature, float humidity)
     return (c * alpha) / (b - alpha);
 }
 
+/**
+ * Body of the background SPS30 task
+ *
+ * The I2C bus is shared with the main task; the Arduino Wire driver serializes
+ * transactions, and the SPS30 driver keeps each command within one transaction.
+ */
+static void sps30_task(void* sps30_sensor)
+{
+    if (!read_sps30_data(*static_cast<SensirionI2cSps30*>(sps30_sensor), sps30_result))
+        LOG_ERROR("Failed to read SPS30 data.");
+    xSemaphoreGive(sps30_done);
+    vTaskDelete(nullptr);
+}
+
 static bool read_sps30_data(SensirionI2cSps30& sps30_sensor, Measurement& measurement)
 {
+    perf_begin(PERF_SPS30_WARMUP);
     sps30_sensor.begin(Wire, SPS30_I2C_ADDR_69);
 
     int16_t wakeup_error = sps30_sensor.wakeUpSequence();
     if (wakeup_error != 0) {
-        serial_log("SPS30: wakeUpSequence failed with error " + String(wakeup_error) + ".");
+        LOG_ERROR("SPS30: wakeUpSequence failed with error %d.", wakeup_error);
+        sensor_missing(SENSOR_SPS30);
+        perf_end(PERF_SPS30_WARMUP);
         return false;
     }
 
+    sensor_found(SENSOR_SPS30, SPS30_I2C_ADDR_69);
+
     int16_t stop_error = sps30_sensor.stopMeasurement();
     if (stop_error != 0)
-        serial_log("SPS30: stopMeasurement returned non-zero (continuing).");
-	delay(100);
+        LOG_WARN("SPS30: stopMeasurement returned non-zero (continuing).");
+	wait_for(100);
 
 	// TODO: printSPS30diagnostics(sps30_sensor);
 
     int16_t start_error = sps30_sensor.startMeasurement(SPS30_OUTPUT_FORMAT_OUTPUT_FORMAT_FLOAT);
     if (start_error != 0) {
-        serial_log("SPS30: startMeasurement failed with error " + String(start_error) + ".");
+        LOG_ERROR("SPS30: startMeasurement failed with error %d.", start_error);
+        perf_end(PERF_SPS30_WARMUP);
         return false;
     }
 
-	if (cycles_since_sps30_cleaning >= SPS30_CLEANING_INTERVAL_CYCLES) {
-		serial_log("SPS30: starting fan cleaning...");
+	if (schedule_due(JOB_SPS30_CLEANING)) {
+		LOG_INFO("SPS30: starting fan cleaning...");
 
 		int16_t cleaning_error = sps30_sensor.startFanCleaning();
 		if (cleaning_error != 0) {
-			serial_log("SPS30: startFanCleaning failed with error " + String(cleaning_error) + ".");
+			LOG_ERROR("SPS30: startFanCleaning failed with error %d.", cleaning_error);
 		} else {
-			serial_log("SPS30: fan cleaning started successfully.");
-			delay(SPS30_CLEANING_TIME_S * 1000);
-			serial_log("SPS30: fan cleaning completed.");
+			LOG_INFO("SPS30: fan cleaning started successfully.");
+			wait_for(SPS30_CLEANING_TIME_S * 1000);
+			LOG_INFO("SPS30: fan cleaning completed.");
 		}
 
 		/**
-		 * Same as with the measurement interval, we want to update the cleaning
-		 * cycle count regardless of whether the cleaning was successful or not,
+		 * Same as with the measurement interval, we want to reschedule the
+		 * cleaning regardless of whether it was successful or not,
 		 * to avoid draining the battery with repeated failed cleaning attempts.
 		 */
-		cycles_since_sps30_cleaning = SPS30_CLEANING_INTERVAL_CYCLES;
+		schedule_done(JOB_SPS30_CLEANING);
 
 		// TODO: maybe, in case of cleaning failure, let's not wait the full
 		// interval before the next cleaning attempt, but rather, half the interval?
 	} else {
-		cycles_since_sps30_cleaning++;
-		serial_log("SPS30: skipping fan cleaning this cycle (scheduled interval).");
+		LOG_INFO("SPS30: skipping fan cleaning this cycle (scheduled interval).");
 	}
 
-    serial_log("SPS30: waiting " + String(SPS30_STARTUP_TIME_S) + "s startup stabilization time...");
-    delay(SPS30_STARTUP_TIME_S * 1000);
-
-	uint16_t data_ready_flag = 0;
+    LOG_INFO("SPS30: waiting %ds startup stabilization time...", SPS30_STARTUP_TIME_S);
+    wait_for(SPS30_STARTUP_TIME_S * 1000);
+    perf_end(PERF_SPS30_WARMUP);
+    perf_begin(PERF_SPS30_SAMPLING);
+
+    /**
+     * Samples are taken until the 95% confidence interval of the PM2.5 mean is
+     * narrow enough, within SPS30_MIN_READINGS and SPS30_NUM_READINGS; in steady
+     * air that is a few seconds before the maximum. The reported values are the
+     * medians, so a single spike does not skew them.
+     */
+    uint16_t data_ready_flag = 0;
     uint8_t valid_readings = 0;
-    float sum_mc_pm1_0 = 0.0f;
-    float sum_mc_pm2_5 = 0.0f;
-    float sum_mc_pm10_0 = 0.0f;
+    float samples_mc_pm1_0[SPS30_NUM_READINGS];
+    float samples_mc_pm2_5[SPS30_NUM_READINGS];
+    float samples_mc_pm10_0[SPS30_NUM_READINGS];
+    RunningStats stats_mc_pm2_5;
 
     for (uint8_t i = 0; i < SPS30_NUM_READINGS; ++i) {
-        delay(SPS30_SAMPLING_INTERVAL_S * 1000);
+        wait_for(SPS30_SAMPLING_INTERVAL_S * 1000);
 
         int16_t data_ready_error = sps30_sensor.readDataReadyFlag(data_ready_flag);
         if (data_ready_error != NO_ERROR) {
-            serial_log("SPS30: readDataReadyFlag failed for sample " + String(i + 1) + " with error " + String(data_ready_error) + ".");
+            LOG_WARN("SPS30: readDataReadyFlag failed for sample %d with error %d.", i + 1, data_ready_error);
             continue;
         }
 
         if (data_ready_flag != 1) {
-            serial_log("SPS30: data not ready for sample " + String(i + 1) + ".");
+            LOG_WARN("SPS30: data not ready for sample %d.", i + 1);
             continue;
         }
 
@@ -317,46 +492,71 @@ static bool read_sps30_data(SensirionI2cSps30& sps30_sensor, Measurement& measur
 				raw_ignored, // nc_pm10_0
                 raw_ignored); // typical_particle_size
         if (read_error != NO_ERROR) {
-			serial_log("SPS30: readMeasurementValuesFloat failed for sample " + String(i + 1) + " with error " + String(read_error) + ".");
+			LOG_WARN("SPS30: readMeasurementValuesFloat failed for sample %d with error %d.", i + 1, read_error);
             continue;
         }
 
-		if (SPS30_DEBUG_VALUES) {
-			serial_log("----------------------------------------");
-            serial_log("SPS30: sample " + String(i + 1) + " values:");
-			serial_log("  MC PM1.0: " + String(raw_mc_pm1_0) + " ug/m3");
-			serial_log("  MC PM2.5: " + String(raw_mc_pm2_5) + " ug/m3");
-			serial_log("  MC PM10.0: " + String(raw_mc_pm10_0) + " ug/m3");
-			serial_log("----------------------------------------");
-		}
+		LOG_DEBUG("----------------------------------------");
+		LOG_DEBUG("SPS30: sample %d values:", i + 1);
+		LOG_DEBUG("  MC PM1.0: %.2f ug/m3", raw_mc_pm1_0);
+		LOG_DEBUG("  MC PM2.5: %.2f ug/m3", raw_mc_pm2_5);
+		LOG_DEBUG("  MC PM10.0: %.2f ug/m3", raw_mc_pm10_0);
+		LOG_DEBUG("----------------------------------------");
 
-        sum_mc_pm1_0 += raw_mc_pm1_0;
-        sum_mc_pm2_5 += raw_mc_pm2_5;
-        sum_mc_pm10_0 += raw_mc_pm10_0;
+        samples_mc_pm1_0[valid_readings] = raw_mc_pm1_0;
+        samples_mc_pm2_5[valid_readings] = raw_mc_pm2_5;
+        samples_mc_pm10_0[valid_readings] = raw_mc_pm10_0;
         ++valid_readings;
+        stats_mc_pm2_5.add(raw_mc_pm2_5);
+
+        if (valid_readings >= SPS30_MIN_READINGS) {
+            float half_width = stats_mc_pm2_5.confidence_half_width();
+            float tolerance = max((float)SPS30_PM2_5_TOLERANCE, stats_mc_pm2_5.mean * SPS30_PM2_5_TOLERANCE_PERCENT / 100.0f);
+            if (half_width <= tolerance) {
+                LOG_INFO("SPS30: PM2.5 settled after %u readings (+/- %.2f ug/m3).", valid_readings, half_width);
+                break;
+            }
+        }
     }
 
     if (sps30_sensor.stopMeasurement() != 0)
-        serial_log("SPS30: stopMeasurement failed after sampling.");
+        LOG_WARN("SPS30: stopMeasurement failed after sampling.");
     if (sps30_sensor.sleep() != 0)
-        serial_log("SPS30: sleep command failed.");
+        LOG_WARN("SPS30: sleep command failed.");
+    perf_end(PERF_SPS30_SAMPLING);
 
     if (valid_readings == 0) {
-        serial_log("SPS30: no valid readings collected.");
+        LOG_ERROR("SPS30: no valid readings collected.");
         return false;
     }
 
-	measurement.mc_pm1_0 = std::make_unique<float>(sum_mc_pm1_0 / valid_readings);
-	measurement.mc_pm2_5 = std::make_unique<float>(sum_mc_pm2_5 / valid_readings);
-	measurement.mc_pm10_0 = std::make_unique<float>(sum_mc_pm10_0 / valid_readings);
+	measurement.set(Measurement::MC_PM1_0, median(samples_mc_pm1_0, valid_readings));
+	measurement.set(Measurement::MC_PM2_5, median(samples_mc_pm2_5, valid_readings));
+	measurement.set(Measurement::MC_PM10_0, median(samples_mc_pm10_0, valid_readings));
 
-	if(SPS30_DEBUG_VALUES) {
-		serial_log("SPS30: averaged values:");
-		serial_log("  MC PM1.0: " + String(*measurement.mc_pm1_0) + " ug/m3");
-		serial_log("  MC PM2.5: " + String(*measurement.mc_pm2_5) + " ug/m3");
-		serial_log("  MC PM10.0: " + String(*measurement.mc_pm10_0) + " ug/m3");
-	}
+	LOG_DEBUG("SPS30: median values:");
+	LOG_DEBUG("  MC PM1.0: %.2f ug/m3", measurement.get(Measurement::MC_PM1_0));
+	LOG_DEBUG("  MC PM2.5: %.2f ug/m3", measurement.get(Measurement::MC_PM2_5));
+	LOG_DEBUG("  MC PM10.0: %.2f ug/m3", measurement.get(Measurement::MC_PM10_0));
 
-    serial_log("SPS30: averaged " + String(valid_readings) + " valid readings.");
+    LOG_INFO("SPS30: median of %u valid readings.", valid_readings);
     return true;
 }
+
+/**
+ * Median of the first `count` values; reorders them
+ */
+static float median(float* values, uint8_t count)
+{
+    // insertion sort, there are only a handful
+    for (uint8_t i = 1; i < count; i++) {
+        float value = values[i];
+        uint8_t j = i;
+        for (; j > 0 && values[j - 1] > value; j--)
+            values[j] = values[j - 1];
+        values[j] = value;
+    }
+    if (count % 2 == 1)
+        return values[count / 2];
+    return (values[count / 2 - 1] + values[count / 2]) / 2;
+}
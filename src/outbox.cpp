@@ -0,0 +1,240 @@
+#include "outbox.h"
+#include "clock.h"
+#include "collector_packet.h"
+#include "env.h"
+#include "influxdb.h"
+#include "utils.h"
+
+#include <LittleFS.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define OUTBOX_PATH "/outbox.bin"
+#define OUTBOX_MAGIC 0x584f4257 // "WBOX"
+
+/**
+ * A record is the length of the encoded point followed by the point, padded to
+ * the longest encoding
+ */
+#define OUTBOX_RECORD_SIZE (1 + COLLECTOR_POINT_MAX_LENGTH)
+
+/**
+ * Points per InfluxDB write while draining
+ */
+#define OUTBOX_DRAIN_BATCH 32
+
+static_assert(OUTBOX_CAPACITY > 0 && OUTBOX_CAPACITY <= 65535, "OUTBOX_CAPACITY must fit the 16-bit ring indices");
+
+/**
+ * Start of the file, followed by the records
+ */
+struct OutboxHeader {
+    uint32_t magic;
+    uint16_t capacity;
+    uint16_t oldest;
+    uint16_t count;
+    uint16_t record_size; // OUTBOX_RECORD_SIZE, which follows the collector datagram format
+};
+
+/**
+ * The count is mirrored in RTC memory, so most cycles can tell whether there is
+ * anything to drain without mounting the file system.
+ * Records older than the last power-on may carry timestamps counted from a
+ * previous power-on, which no clock synchronization can fix; they are the
+ * oldest `outbox_stale` ones.
+ */
+RTC_DATA_ATTR bool outbox_opened = false; // since power-on
+RTC_DATA_ATTR uint16_t outbox_size = 0;
+RTC_DATA_ATTR uint16_t outbox_stale = 0;
+
+// one line per point, each followed by a newline
+static char drain_payload[OUTBOX_DRAIN_BATCH * (INFLUXDB_LINE_MAX_LENGTH + 1)];
+
+static bool open_outbox(File& file, OutboxHeader& header);
+static void write_header(File& file, const OutboxHeader& header);
+static void remove_oldest(OutboxHeader& header, uint16_t count);
+
+static SemaphoreHandle_t outbox_lock()
+{
+    // the drain runs in an upload task, which may still be going when the main task adds a point
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    return lock;
+}
+
+void outbox_add(const Measurement& measurement)
+{
+    CollectorPoint point;
+    point.timestamp = measurement.timestamp;
+    point.present = measurement.present;
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++)
+        point.values[i] = measurement.values[i];
+
+    uint8_t record[OUTBOX_RECORD_SIZE] = {};
+    record[0] = collector_encode_point(record + 1, sizeof(record) - 1, 0, 0, 0, 0, point);
+
+    xSemaphoreTake(outbox_lock(), portMAX_DELAY);
+    File file;
+    OutboxHeader header;
+    if (open_outbox(file, header)) {
+        if (header.count == header.capacity) {
+            LOG_WARN("Outbox full - dropping the oldest point.");
+            remove_oldest(header, 1);
+        }
+        uint16_t index = (header.oldest + header.count) % header.capacity;
+        file.seek(sizeof(header) + (size_t)index * OUTBOX_RECORD_SIZE);
+        file.write(record, sizeof(record));
+        header.count++;
+        write_header(file, header);
+        file.close();
+        LOG_INFO("Point stored in the outbox (%u waiting).", header.count);
+    }
+    xSemaphoreGive(outbox_lock());
+}
+
+uint16_t outbox_count()
+{
+    if (!outbox_opened) {
+        // after a power-on, the file may still hold points
+        xSemaphoreTake(outbox_lock(), portMAX_DELAY);
+        File file;
+        OutboxHeader header;
+        if (open_outbox(file, header))
+            file.close();
+        xSemaphoreGive(outbox_lock());
+    }
+    return outbox_size;
+}
+
+bool outbox_drain(uint32_t timeout_ms)
+{
+    if (outbox_count() == 0)
+        return true;
+
+    unsigned long start = millis();
+    if (!clock_synchronized()) {
+        LOG_WARN("Clock not synchronized - keeping %u points in the outbox.", outbox_size);
+        return false;
+    }
+
+    xSemaphoreTake(outbox_lock(), portMAX_DELAY);
+    File file;
+    OutboxHeader header;
+    bool drained = open_outbox(file, header);
+    while (drained && header.count > 0) {
+        uint32_t elapsed_ms = millis() - start;
+        if (elapsed_ms >= timeout_ms) {
+            drained = false;
+            break;
+        }
+
+        uint16_t batch = min(header.count, (uint16_t)OUTBOX_DRAIN_BATCH);
+        uint16_t lines = 0;
+        PayloadWriter payload(drain_payload, sizeof(drain_payload));
+        for (uint16_t i = 0; i < batch; i++) {
+            uint8_t record[OUTBOX_RECORD_SIZE];
+            file.seek(sizeof(header) + (size_t)((header.oldest + i) % header.capacity) * OUTBOX_RECORD_SIZE);
+            CollectorPacket packet;
+            CollectorPoint point;
+            if (file.read(record, sizeof(record)) != sizeof(record) || record[0] > COLLECTOR_POINT_MAX_LENGTH
+                || !collector_decode(record + 1, record[0], packet) || !collector_decode_point(packet, point)) {
+                LOG_WARN("Outbox record %u is corrupt - skipping it.", (header.oldest + i) % header.capacity);
+                continue;
+            }
+            if (point.timestamp < VALID_EPOCH) {
+                if (i < outbox_stale || clock_offset() == 0) {
+                    LOG_WARN("Outbox point from before a power loss has no usable time - skipping it.");
+                    continue;
+                }
+                point.timestamp += clock_offset();
+            }
+
+            Measurement measurement;
+            measurement.timestamp = point.timestamp;
+            measurement.present = point.present;
+            for (uint8_t field = 0; field < COLLECTOR_FIELD_COUNT; field++)
+                measurement.values[field] = point.values[field];
+            if (lines++ > 0)
+                payload.append('\n');
+            write_line_protocol(payload, measurement);
+        }
+
+        // InfluxDB would reject the whole write for a cut line, and the same records would come up every time
+        bool too_long = payload.overflowed();
+        if (too_long) {
+            LOG_ERROR("Outbox: payload too long - dropping %u points.", lines);
+        } else if (lines > 0 && !post_to_influx_db(payload.c_str(), payload.length(), timeout_ms - elapsed_ms)) {
+            drained = false;
+            break;
+        }
+        remove_oldest(header, batch);
+        write_header(file, header);
+        if (!too_long)
+            LOG_INFO("Outbox: %u points written, %u waiting.", lines, header.count);
+    }
+    if (file)
+        file.close();
+    xSemaphoreGive(outbox_lock());
+    return drained;
+}
+
+/**
+ * Opens the outbox file for reading and writing, creating it if it does not exist
+ * or was written with a different capacity or record format, and reads its header
+ *
+ * @note The caller holds the lock.
+ */
+static bool open_outbox(File& file, OutboxHeader& header)
+{
+    static bool mounted = false;
+    if (!mounted) {
+        mounted = LittleFS.begin(true);
+        if (!mounted) {
+            LOG_ERROR("Failed to mount LittleFS - no outbox.");
+            return false;
+        }
+    }
+
+    if (LittleFS.exists(OUTBOX_PATH)) {
+        file = LittleFS.open(OUTBOX_PATH, "r+");
+        if (file && file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) && header.magic == OUTBOX_MAGIC
+            && header.capacity == OUTBOX_CAPACITY && header.record_size == OUTBOX_RECORD_SIZE && header.oldest < header.capacity && header.count <= header.capacity) {
+            if (!outbox_opened)
+                outbox_stale = header.count;
+            outbox_opened = true;
+            outbox_size = header.count;
+            return true;
+        }
+        if (file)
+            file.close();
+        LOG_WARN("Outbox file unreadable or of another capacity or format - starting over.");
+    }
+
+    file = LittleFS.open(OUTBOX_PATH, "w+");
+    if (!file) {
+        LOG_ERROR("Failed to create the outbox file.");
+        return false;
+    }
+    header = { OUTBOX_MAGIC, OUTBOX_CAPACITY, 0, 0, OUTBOX_RECORD_SIZE };
+    write_header(file, header);
+    outbox_opened = true;
+    outbox_stale = 0;
+    return true;
+}
+
+static void write_header(File& file, const OutboxHeader& header)
+{
+    file.seek(0);
+    file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    outbox_size = header.count;
+}
+
+/**
+ * Drops the oldest `count` records; the header is written by the caller
+ */
+static void remove_oldest(OutboxHeader& header, uint16_t count)
+{
+    header.oldest = (header.oldest + count) % header.capacity;
+    header.count -= count;
+    outbox_stale = outbox_stale > count ? outbox_stale - count : 0;
+}
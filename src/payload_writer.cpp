@@ -0,0 +1,121 @@
+#include "payload_writer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t powers_of_ten[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+/**
+ * Writes the decimal digits of value, at least min_digits of them (zero padded)
+ */
+static size_t format_unsigned(char* out, uint32_t value, uint8_t min_digits)
+{
+    char digits[10];
+    uint8_t count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    while (count < min_digits)
+        digits[count++] = '0';
+
+    for (uint8_t i = 0; i < count; i++)
+        out[i] = digits[count - 1 - i];
+    return count;
+}
+
+size_t format_fixed(char* out, float value, uint8_t decimals)
+{
+    if (decimals > 6)
+        decimals = 6;
+
+    if (isnan(value)) {
+        memcpy(out, "nan", 3);
+        return 3;
+    }
+    if (isinf(value)) {
+        memcpy(out, value < 0 ? "-inf" : "inf", value < 0 ? 4 : 3);
+        return value < 0 ? 4 : 3;
+    }
+
+    float magnitude = fabsf(value);
+    if (magnitude >= 4294967040.0f) // largest float below 2^32
+        return snprintf(out, FORMAT_FIXED_MAX_LENGTH, "%.*e", decimals, value);
+
+    uint32_t scale = powers_of_ten[decimals];
+    uint32_t integer = (uint32_t)magnitude;
+    uint32_t fraction = (uint32_t)((magnitude - integer) * scale + 0.5f);
+    if (fraction >= scale) {
+        integer++;
+        fraction -= scale;
+    }
+
+    size_t length = 0;
+    if (value < 0 && (integer != 0 || fraction != 0))
+        out[length++] = '-';
+    length += format_unsigned(out + length, integer, 1);
+    if (decimals > 0) {
+        out[length++] = '.';
+        length += format_unsigned(out + length, fraction, decimals);
+    }
+    return length;
+}
+
+PayloadWriter::PayloadWriter(char* buffer, size_t capacity)
+    : buffer_(buffer)
+    , capacity_(capacity)
+    , length_(0)
+    , overflowed_(false)
+{
+    if (capacity_ > 0)
+        buffer_[0] = '\0';
+}
+
+PayloadWriter& PayloadWriter::append(const char* text) { return append(text, strlen(text)); }
+
+PayloadWriter& PayloadWriter::append(const char* data, size_t length)
+{
+    size_t room = capacity_ > length_ ? capacity_ - length_ - 1 : 0;
+    if (length > room) {
+        length = room;
+        overflowed_ = true;
+    }
+    memcpy(buffer_ + length_, data, length);
+    length_ += length;
+    if (capacity_ > 0)
+        buffer_[length_] = '\0';
+    return *this;
+}
+
+PayloadWriter& PayloadWriter::append(char c) { return append(&c, 1); }
+
+PayloadWriter& PayloadWriter::append(int32_t value)
+{
+    char text[11];
+    size_t length = 0;
+    if (value < 0)
+        text[length++] = '-';
+    length += format_unsigned(text + length, value < 0 ? 0u - (uint32_t)value : (uint32_t)value, 1);
+    return append(text, length);
+}
+
+PayloadWriter& PayloadWriter::append(uint32_t value)
+{
+    char text[10];
+    return append(text, format_unsigned(text, value, 1));
+}
+
+PayloadWriter& PayloadWriter::append(float value, uint8_t decimals)
+{
+    char text[FORMAT_FIXED_MAX_LENGTH];
+    return append(text, format_fixed(text, value, decimals));
+}
+
+void PayloadWriter::clear()
+{
+    length_ = 0;
+    overflowed_ = false;
+    if (capacity_ > 0)
+        buffer_[0] = '\0';
+}
@@ -0,0 +1,124 @@
+#include "perf.h"
+#include "clock.h"
+#include "env.h"
+#include "heap_stats.h"
+#include "utils.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+RTC_DATA_ATTR PerfRecord perf_history[PERF_HISTORY_SIZE];
+RTC_DATA_ATTR uint8_t perf_oldest = 0;
+RTC_DATA_ATTR uint8_t perf_size = 0;
+
+static PerfRecord perf_current;
+static unsigned long perf_started_us[PERF_PHASE_COUNT];
+
+/**
+ * Phase names, in PerfPhase order; the InfluxDB fields add "_us"
+ */
+static const char* const phase_names[PERF_PHASE_COUNT] = {
+    "boot",
+    "first_i2c",
+    "bmp280_begin",
+    "bmp280_read",
+    "aht20_begin",
+    "aht20_read",
+    "bh1750_begin",
+    "bh1750_read",
+    "ads1115_begin",
+    "ads1115_read",
+    "sps30_warmup",
+    "sps30_sampling",
+    "wifi_connect",
+    "clock_sync",
+    "wunderground",
+    "influxdb",
+    "collector",
+    "outbox",
+    "send_log",
+    "active",
+};
+
+static_assert(PERF_HISTORY_SIZE > 0 && PERF_HISTORY_SIZE <= 255, "PERF_HISTORY_SIZE must be between 1 and 255");
+
+static void write_record(PayloadWriter& payload, const PerfRecord& record, bool with_timestamp);
+
+void perf_begin(PerfPhase phase)
+{
+    heap_phase_begin(phase);
+    perf_started_us[phase] = micros();
+}
+
+void perf_end(PerfPhase phase)
+{
+    perf_current.phase_us[phase] += micros() - perf_started_us[phase];
+    heap_phase_end(phase);
+}
+
+void perf_start_cycle() { perf_mark(PERF_BOOT); }
+
+void perf_mark(PerfPhase phase) { perf_current.phase_us[phase] = micros(); }
+
+void perf_finish_cycle()
+{
+    perf_current.phase_us[PERF_ACTIVE] = micros();
+    perf_current.free_heap = ESP.getFreeHeap();
+    perf_current.min_free_heap = ESP.getMinFreeHeap();
+    perf_current.largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    perf_current.timestamp = time(nullptr);
+
+    uint8_t index = (perf_oldest + perf_size) % PERF_HISTORY_SIZE;
+    if (perf_size == PERF_HISTORY_SIZE)
+        perf_oldest = (perf_oldest + 1) % PERF_HISTORY_SIZE;
+    else
+        perf_size++;
+    perf_history[index] = perf_current;
+    heap_finish_cycle();
+}
+
+const char* perf_phase_name(PerfPhase phase) { return phase_names[phase]; }
+
+uint8_t perf_write_history(PayloadWriter& payload)
+{
+    // newest record without a valid timestamp, the only one of them that is written
+    int newest_unsynchronized = -1;
+    for (uint8_t i = 0; i < perf_size; i++)
+        if (perf_history[(perf_oldest + i) % PERF_HISTORY_SIZE].timestamp < VALID_EPOCH)
+            newest_unsynchronized = i;
+
+    for (uint8_t i = 0; i < perf_size; i++) {
+        const PerfRecord& record = perf_history[(perf_oldest + i) % PERF_HISTORY_SIZE];
+        bool synchronized = record.timestamp >= VALID_EPOCH;
+        if (!synchronized && i != newest_unsynchronized)
+            continue;
+        if (payload.length() > 0)
+            payload.append('\n');
+        write_record(payload, record, synchronized);
+    }
+    return perf_size;
+}
+
+void perf_clear_history(uint8_t count)
+{
+    if (count > perf_size)
+        count = perf_size;
+    perf_oldest = (perf_oldest + count) % PERF_HISTORY_SIZE;
+    perf_size -= count;
+}
+
+static void write_record(PayloadWriter& payload, const PerfRecord& record, bool with_timestamp)
+{
+    payload.append("firmware_perf ");
+    for (uint8_t phase = 0; phase < PERF_PHASE_COUNT; phase++) {
+        // phases that did not run this cycle are left out, like missing sensor values
+        if (record.phase_us[phase] == 0)
+            continue;
+        payload.append(phase_names[phase]).append("_us=").append(record.phase_us[phase]).append("i,");
+    }
+    payload.append("free_heap=").append(record.free_heap).append("i,");
+    payload.append("min_free_heap=").append(record.min_free_heap).append("i,");
+    payload.append("largest_free_block=").append(record.largest_free_block).append('i');
+    if (with_timestamp)
+        payload.append(' ').append(record.timestamp);
+}
@@ -0,0 +1,108 @@
+#include "power.h"
+#include "env.h"
+#include "utils.h"
+
+#include <time.h>
+
+/**
+ * Weight of a new battery reading in the smoothed voltage and trend. The ADS1115
+ * reading jumps with the load (WiFi, SPS30 fan), so single readings are not trusted.
+ */
+#define POWER_SMOOTHING 0.25f
+
+/**
+ * Readings further apart than this (e.g. across a clock synchronization) do not
+ * update the trend
+ */
+#define POWER_MAX_TREND_GAP_S (6 * 3600)
+
+// the critical tier has the longest cycle; its readings have to come close enough together to show a trend
+static_assert(POWER_ECONOMY_CYCLE_FACTOR >= 1 && POWER_CRITICAL_CYCLE_FACTOR >= POWER_ECONOMY_CYCLE_FACTOR,
+    "each power tier must cycle at least as slowly as the one above it");
+static_assert((uint64_t)CYCLE_TIME_SEC * POWER_CRITICAL_CYCLE_FACTOR <= POWER_MAX_TREND_GAP_S,
+    "CYCLE_TIME_SEC * POWER_CRITICAL_CYCLE_FACTOR is too long a cycle for the battery trend");
+
+struct PowerState {
+    bool initialized;
+    PowerTier tier;
+    float battery_voltage; // smoothed
+    float trend_v_per_h; // smoothed
+    uint32_t updated_at; // time(), seconds
+};
+
+RTC_DATA_ATTR PowerState power_state = { false, POWER_NORMAL, 0, 0, 0 };
+
+static const char* const power_tier_names[] = { "normal", "economy", "critical" };
+
+static PowerTier tier_for(float outlook_voltage, bool charging);
+
+PowerPlan power_plan()
+{
+    switch (power_state.tier) {
+    case POWER_CRITICAL:
+        return PowerPlan { POWER_CRITICAL, CYCLE_TIME_SEC * POWER_CRITICAL_CYCLE_FACTOR, INFLUXDB_BATCH_CAPACITY, false, false };
+    case POWER_ECONOMY:
+        return PowerPlan { POWER_ECONOMY, CYCLE_TIME_SEC * POWER_ECONOMY_CYCLE_FACTOR,
+            max(INFLUXDB_BATCH_CYCLES, POWER_ECONOMY_BATCH_CYCLES), false, true };
+    default:
+        return PowerPlan { POWER_NORMAL, CYCLE_TIME_SEC, INFLUXDB_BATCH_CYCLES, true, true };
+    }
+}
+
+void power_update(const Measurement& measurement)
+{
+    if (!measurement.has(Measurement::BATTERY_VOLTAGE_A0))
+        return;
+
+    float voltage = measurement.get(Measurement::BATTERY_VOLTAGE_A0);
+    float solar_voltage = measurement.has(Measurement::SOLAR_PANEL_VOLTAGE_A1) ? measurement.get(Measurement::SOLAR_PANEL_VOLTAGE_A1) : 0;
+    uint32_t now = time(nullptr);
+
+    if (!power_state.initialized) {
+        power_state = PowerState { true, POWER_NORMAL, voltage, 0, now };
+    } else {
+        float previous = power_state.battery_voltage;
+        power_state.battery_voltage += POWER_SMOOTHING * (voltage - previous);
+
+        uint32_t elapsed_s = now - power_state.updated_at;
+        if (elapsed_s > 0 && elapsed_s <= POWER_MAX_TREND_GAP_S) {
+            float trend = (power_state.battery_voltage - previous) * 3600.0f / elapsed_s;
+            power_state.trend_v_per_h += POWER_SMOOTHING * (trend - power_state.trend_v_per_h);
+        }
+        power_state.updated_at = now;
+    }
+
+    // only a falling battery is extrapolated; a rising one has to get there first
+    float outlook = power_state.battery_voltage + min(0.0f, power_state.trend_v_per_h) * POWER_TREND_HORIZON_H;
+    bool charging = solar_voltage >= POWER_SOLAR_CHARGING_V;
+    PowerTier tier = tier_for(outlook, charging);
+
+    if (tier != power_state.tier)
+        LOG_WARN("Power: %s -> %s (battery %.2f V, trend %.3f V/h, solar %.2f V).", power_tier_names[power_state.tier],
+            power_tier_names[tier], power_state.battery_voltage, power_state.trend_v_per_h, solar_voltage);
+    else
+        LOG_INFO("Power: %s (battery %.2f V, trend %.3f V/h, solar %.2f V).", power_tier_names[tier], power_state.battery_voltage,
+            power_state.trend_v_per_h, solar_voltage);
+    power_state.tier = tier;
+}
+
+/**
+ * Tier for the given outlook, starting from the current one: going down at the
+ * threshold, going up only with some margin or while charging
+ */
+static PowerTier tier_for(float outlook_voltage, bool charging)
+{
+    static const float thresholds[] = { POWER_ECONOMY_BELOW_V, POWER_CRITICAL_BELOW_V }; // below tier 0, below tier 1
+
+    PowerTier tier = power_state.tier;
+    while (tier < POWER_CRITICAL && outlook_voltage < thresholds[tier])
+        tier = (PowerTier)(tier + 1);
+    while (tier > POWER_NORMAL) {
+        float threshold = thresholds[tier - 1];
+        bool recovered = outlook_voltage >= threshold + POWER_HYSTERESIS_V || (charging && outlook_voltage >= threshold);
+        if (!recovered)
+            break;
+        tier = (PowerTier)(tier - 1);
+    }
+    return tier;
+}
@@ -0,0 +1,76 @@
+#include "schedule.h"
+#include "env.h"
+#include "utils.h"
+
+struct JobInfo {
+    const char* name; // in the log
+    uint16_t interval_cycles;
+    uint16_t offset_cycles; // first run after power-on
+    uint8_t conditions; // SCHEDULE_*
+};
+
+// in Job order
+static const JobInfo job_info[JOB_COUNT] = {
+    { "bmp280", 1, 0, SCHEDULE_ALWAYS },
+    { "aht20", 1, 0, SCHEDULE_ALWAYS },
+    { "bh1750", 1, 0, SCHEDULE_IN_DAYLIGHT }, // reads a few lx at night, and is the slowest conversion
+    { "uv", 1, 0, SCHEDULE_IN_DAYLIGHT },
+    { "sps30", SPS30_MEASUREMENT_INTERVAL_CYCLES, 0, SCHEDULE_FULL_POWER },
+    { "sps30_cleaning", SPS30_CLEANING_INTERVAL_CYCLES, 0, SCHEDULE_ALWAYS },
+};
+
+struct ScheduleState {
+    bool initialized; // since power-on
+    bool daylight;
+    uint32_t cycle; // wake cycles since power-on
+    uint32_t due_at[JOB_COUNT]; // cycle
+};
+
+RTC_DATA_ATTR ScheduleState schedule_state = {};
+
+/**
+ * Conditions met by this cycle
+ */
+static uint8_t cycle_conditions = SCHEDULE_ALWAYS;
+
+void schedule_begin_cycle(const PowerPlan& plan)
+{
+    if (!schedule_state.initialized) {
+        schedule_state.initialized = true;
+        schedule_state.daylight = true;
+        for (uint8_t i = 0; i < JOB_COUNT; i++)
+            schedule_state.due_at[i] = job_info[i].offset_cycles;
+    } else
+        schedule_state.cycle++;
+
+    cycle_conditions = SCHEDULE_ALWAYS;
+    if (schedule_state.daylight)
+        cycle_conditions |= SCHEDULE_IN_DAYLIGHT;
+    if (plan.particulate_matter)
+        cycle_conditions |= SCHEDULE_FULL_POWER;
+
+    char due[64] = "";
+    size_t length = 0;
+    for (uint8_t i = 0; i < JOB_COUNT && length < sizeof(due); i++)
+        if (schedule_due((Job)i))
+            length += snprintf(due + length, sizeof(due) - length, " %s", job_info[i].name);
+    LOG_DEBUG("Schedule: cycle %lu, %s - due:%s", (unsigned long)schedule_state.cycle,
+        schedule_state.daylight ? "daylight" : "night", length > 0 ? due : " nothing");
+}
+
+bool schedule_due(Job job)
+{
+    const JobInfo& info = job_info[job];
+    return schedule_state.cycle >= schedule_state.due_at[job] && (cycle_conditions & info.conditions) == info.conditions;
+}
+
+void schedule_done(Job job) { schedule_state.due_at[job] = schedule_state.cycle + job_info[job].interval_cycles; }
+
+void schedule_update(const Measurement& measurement)
+{
+    bool daylight = !measurement.has(Measurement::SOLAR_PANEL_VOLTAGE_A1)
+        || measurement.get(Measurement::SOLAR_PANEL_VOLTAGE_A1) >= SCHEDULE_DAYLIGHT_SOLAR_V;
+    if (daylight != schedule_state.daylight)
+        LOG_INFO("Schedule: %s from the next cycle on.", daylight ? "daylight" : "night");
+    schedule_state.daylight = daylight;
+}
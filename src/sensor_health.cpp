@@ -0,0 +1,79 @@
+#include "sensor_health.h"
+#include "env.h"
+#include "utils.h"
+
+struct SensorInfo {
+    const char* name; // in the log and the firmware_sensors line
+    uint8_t addresses[SENSOR_MAX_ADDRESSES]; // the default first; 0: unused
+};
+
+// in Sensor order
+static const SensorInfo sensor_info[SENSOR_COUNT] = {
+    { "bmp280", { 0x77, 0x76 } }, // SDO high or low
+    { "aht20", { 0x38, 0 } },
+    { "bh1750", { 0x23, 0x5c } }, // ADDR low or high
+    { "ads1115", { 0x48, 0 } },
+    { "sps30", { 0x69, 0 } },
+};
+
+struct SensorHealth {
+    uint8_t address; // last answered at, 0: not since power-on
+    uint8_t failures; // probes in a row that failed
+    uint16_t opportunities_to_skip;
+};
+
+RTC_DATA_ATTR SensorHealth sensor_health[SENSOR_COUNT] = {};
+
+bool sensor_probe_due(Sensor sensor)
+{
+    SensorHealth& health = sensor_health[sensor];
+    if (health.opportunities_to_skip == 0)
+        return true;
+    health.opportunities_to_skip--;
+    LOG_DEBUG("%s missing %u times in a row - not probed (%u more skips).", sensor_info[sensor].name, health.failures,
+        health.opportunities_to_skip);
+    return false;
+}
+
+uint8_t sensor_probe_order(Sensor sensor, uint8_t addresses[SENSOR_MAX_ADDRESSES])
+{
+    uint8_t count = 0;
+    if (sensor_health[sensor].address != 0)
+        addresses[count++] = sensor_health[sensor].address;
+    for (uint8_t address : sensor_info[sensor].addresses)
+        if (address != 0 && address != sensor_health[sensor].address)
+            addresses[count++] = address;
+    return count;
+}
+
+void sensor_found(Sensor sensor, uint8_t address)
+{
+    SensorHealth& health = sensor_health[sensor];
+    if (health.address != address)
+        LOG_INFO("Found %s at 0x%02x.", sensor_info[sensor].name, address);
+    health = { address, 0, 0 };
+}
+
+void sensor_missing(Sensor sensor)
+{
+    // 1, 2, 4, ... opportunities without probing, up to SENSOR_BACKOFF_MAX_CYCLES
+    SensorHealth& health = sensor_health[sensor];
+    if (health.failures < 255)
+        health.failures++;
+    health.opportunities_to_skip = min(1u << min(health.failures - 1, 15), (unsigned int)SENSOR_BACKOFF_MAX_CYCLES);
+    LOG_WARN("%s missing %u times in a row - next probe in %u opportunities.", sensor_info[sensor].name, health.failures,
+        health.opportunities_to_skip + 1);
+}
+
+void sensor_write_health(PayloadWriter& payload)
+{
+    if (payload.length() > 0)
+        payload.append('\n');
+    payload.append("firmware_sensors ");
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (i > 0)
+            payload.append(',');
+        payload.append(sensor_info[i].name).append("_address=").append((uint32_t)sensor_health[i].address).append("i,");
+        payload.append(sensor_info[i].name).append("_failures=").append((uint32_t)sensor_health[i].failures).append('i');
+    }
+}
@@ -0,0 +1,91 @@
+#include "uploader.h"
+#include "env.h"
+#include "utils.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+/**
+ * HTTPClient and the TLS handshake need considerably more stack than the SPS30 task
+ */
+#define UPLOAD_TASK_STACK_SIZE 8192
+
+// HTTPClient::setTimeout() takes a 16-bit value
+static_assert(UPLOAD_BUDGET_MS <= 65535, "UPLOAD_BUDGET_MS must fit a 16-bit HTTP timeout");
+
+/**
+ * One started upload. The task fills in succeeded and finished_ms, then gives done;
+ * the waiting task only reads them after taking done.
+ */
+struct UploadSlot {
+    const char* name;
+    UploadSink sink;
+    void* context;
+    unsigned long started_ms;
+    unsigned long deadline_ms;
+    unsigned long finished_ms;
+    bool succeeded;
+    bool reported;
+    SemaphoreHandle_t done;
+};
+
+static UploadSlot upload_slots[UPLOAD_MAX_SINKS];
+static uint8_t upload_slot_count = 0;
+
+static void upload_task(void* parameter);
+
+bool upload_start(const char* name, UploadSink sink, void* context, unsigned long deadline_ms)
+{
+    if (upload_slot_count >= UPLOAD_MAX_SINKS) {
+        LOG_ERROR("Upload %s: too many uploads (UPLOAD_MAX_SINKS).", name);
+        return false;
+    }
+
+    UploadSlot& slot = upload_slots[upload_slot_count];
+    slot = UploadSlot { name, sink, context, millis(), deadline_ms, 0, false, false, xSemaphoreCreateBinary() };
+    if (xTaskCreate(upload_task, name, UPLOAD_TASK_STACK_SIZE, &slot, 1, nullptr) != pdPASS) {
+        LOG_ERROR("Upload %s: could not start the task.", name);
+        vSemaphoreDelete(slot.done);
+        return false;
+    }
+    upload_slot_count++;
+    return true;
+}
+
+bool upload_wait(unsigned long deadline_ms)
+{
+    bool all_succeeded = true;
+    for (uint8_t i = 0; i < upload_slot_count; i++) {
+        UploadSlot& slot = upload_slots[i];
+        if (slot.reported)
+            continue;
+        slot.reported = true;
+
+        long remaining_ms = (long)(deadline_ms - millis());
+        if (xSemaphoreTake(slot.done, pdMS_TO_TICKS(remaining_ms > 0 ? remaining_ms : 0)) != pdTRUE) {
+            // the task keeps the semaphore and the slot; deep sleep ends it
+            LOG_ERROR("Upload %s: abandoned after %lu ms (UPLOAD_BUDGET_MS).", slot.name, millis() - slot.started_ms);
+            all_succeeded = false;
+            continue;
+        }
+        vSemaphoreDelete(slot.done);
+
+        if (slot.succeeded)
+            LOG_INFO("Upload %s: ok in %lu ms.", slot.name, slot.finished_ms - slot.started_ms);
+        else
+            LOG_WARN("Upload %s: failed after %lu ms.", slot.name, slot.finished_ms - slot.started_ms);
+        all_succeeded = all_succeeded && slot.succeeded;
+    }
+    return all_succeeded;
+}
+
+static void upload_task(void* parameter)
+{
+    UploadSlot& slot = *static_cast<UploadSlot*>(parameter);
+    long remaining_ms = (long)(slot.deadline_ms - millis());
+    slot.succeeded = remaining_ms > 0 && slot.sink(slot.context, remaining_ms);
+    slot.finished_ms = millis();
+    xSemaphoreGive(slot.done);
+    vTaskDelete(nullptr);
+}
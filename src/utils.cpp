@@ -1,19 +1,12 @@
 #include "utils.h"
 #include "env.h"
+#include "payload_writer.h"
+#include "wait.h"
 
 #include "driver/rtc_io.h"
 
 #include <HTTPClient.h>
 #include <WiFi.h>
-#include <WiFiClient.h>
-
-String log_buffer = "";
-
-void serial_log(String message)
-{
-    log_buffer += message + "\n";
-    Serial.println(message);
-}
 
 void isolate_all_rtc_gpio()
 {
@@ -28,65 +21,151 @@ void isolate_all_rtc_gpio()
 #endif
 }
 
-void connect_to_wifi()
+/**
+ * After a connection has been established once, the BSSID, channel and DHCP lease
+ * are kept in RTC memory. The next wake connects directly to that access point
+ * with a static configuration, skipping the scan and the DHCP exchange, which is
+ * most of the association time.
+ */
+struct WifiCache {
+    bool valid;
+    uint8_t uses; // fast connects since the lease was last obtained from DHCP
+    uint8_t bssid[6];
+    int32_t channel;
+    uint32_t local_ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+RTC_DATA_ATTR WifiCache wifi_cache = {};
+
+/**
+ * Give up on the cached parameters after this long and do a full connect instead
+ */
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000
+
+/**
+ * Longest wait for a full connect with scan and DHCP
+ */
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+
+/**
+ * Renew the lease over DHCP every N fast connects, so the router does not hand
+ * out our address to another client once the lease it knows about has expired
+ */
+#define WIFI_CACHE_MAX_USES 100
+
+/**
+ * Consecutive failed connects and the cycles still to skip before the next
+ * attempt, so an unreachable access point costs a 10 s scan less and less often
+ */
+struct WifiBackoff {
+    uint8_t failures;
+    uint16_t cycles_to_skip;
+};
+
+RTC_DATA_ATTR WifiBackoff wifi_backoff = {};
+
+static bool fast_connect_to_wifi()
 {
-    serial_log("Connecting to WiFi...");
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    for (int i = 0; i < 50; i++) {
-        if (WiFi.status() == WL_CONNECTED) {
-            serial_log("\nWiFi connected!");
-            serial_log(WiFi.localIP().toString());
-            return;
-        }
-        if (WiFi.status() == WL_NO_SSID_AVAIL) {
-            Serial.println("SSID not found!");
-            Serial.println("Entering deep sleep for 5 minutes.");
-            esp_sleep_enable_timer_wakeup(300000000);
-            esp_deep_sleep_start();
-        }
-        delay(200); // 50*200ms gives us max 10s to connect
-        serial_log(".");
-    }
+    WiFi.config(wifi_cache.local_ip, wifi_cache.gateway, wifi_cache.subnet, wifi_cache.dns);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifi_cache.channel, wifi_cache.bssid);
 
-    Serial.println("Response: " + String(WiFi.status()));
-    ESP.restart();
+    wait_until(
+        []() {
+            wl_status_t status = WiFi.status();
+            return status == WL_CONNECTED || status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED;
+        },
+        WIFI_FAST_CONNECT_TIMEOUT_MS);
+    return WiFi.status() == WL_CONNECTED;
 }
 
-void send_log()
+static void save_wifi_cache()
 {
-    WiFiClient client;
-    if (client.connect(LOG_SERVER_HOST, LOG_SERVER_PORT)) {
-        int contentLength = log_buffer.length();
-        client.print(String("POST ") + LOG_SERVER_PATH + " HTTP/1.1\r\n" + "Host: " + LOG_SERVER_HOST + "\r\n"
-            + "Content-Type: text/plain\r\n" + "Content-Length: " + String(contentLength) + "\r\n" + "Connection: close\r\n\r\n"
-            + log_buffer);
+    memcpy(wifi_cache.bssid, WiFi.BSSID(), sizeof(wifi_cache.bssid));
+    wifi_cache.channel = WiFi.channel();
+    wifi_cache.local_ip = WiFi.localIP();
+    wifi_cache.gateway = WiFi.gatewayIP();
+    wifi_cache.subnet = WiFi.subnetMask();
+    wifi_cache.dns = WiFi.dnsIP(0);
+    wifi_cache.uses = 0;
+    wifi_cache.valid = true;
+}
 
-        delay(10);
-        client.stop();
+bool connect_to_wifi()
+{
+    LOG_INFO("Connecting to WiFi...");
+    unsigned long start = millis();
 
-        serial_log("Log sent synchronously (no response expected).");
-    } else {
-        serial_log("Failed to connect to the log server.");
+    if (WIFI_FAST_CONNECT && wifi_cache.valid && wifi_cache.uses < WIFI_CACHE_MAX_USES) {
+        if (fast_connect_to_wifi()) {
+            wifi_cache.uses++;
+            wifi_backoff = {};
+            LOG_INFO("WiFi connected in %lu ms (cached BSSID, channel and IP).", millis() - start);
+            return true;
+        }
+        LOG_WARN("Fast reconnect failed - falling back to full connect.");
+        WiFi.disconnect();
+    }
+
+    // back to scanning and DHCP
+    wifi_cache.valid = false;
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    wait_until([]() { return WiFi.status() == WL_CONNECTED || WiFi.status() == WL_NO_SSID_AVAIL; }, WIFI_CONNECT_TIMEOUT_MS);
+    if (WiFi.status() == WL_CONNECTED) {
+        IPAddress ip = WiFi.localIP();
+        LOG_INFO("WiFi connected!");
+        LOG_INFO("%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+        LOG_INFO("WiFi connected in %lu ms (full scan and DHCP).", millis() - start);
+        if (WIFI_FAST_CONNECT)
+            save_wifi_cache();
+        wifi_backoff = {};
+        return true;
     }
+    if (WiFi.status() == WL_NO_SSID_AVAIL)
+        LOG_ERROR("SSID not found!");
+
+    LOG_ERROR("Response: %d", WiFi.status());
+    WiFi.mode(WIFI_OFF);
+
+    // 1, 2, 4, ... cycles without trying, up to WIFI_BACKOFF_MAX_CYCLES
+    if (wifi_backoff.failures < 15)
+        wifi_backoff.failures++;
+    wifi_backoff.cycles_to_skip = min(1u << (wifi_backoff.failures - 1), (unsigned int)WIFI_BACKOFF_MAX_CYCLES);
+    LOG_WARN("WiFi failed %u times in a row - next attempt in %u cycles.", wifi_backoff.failures, wifi_backoff.cycles_to_skip + 1);
+    return false;
+}
+
+bool wifi_backoff_elapsed()
+{
+    if (wifi_backoff.cycles_to_skip == 0)
+        return true;
+    wifi_backoff.cycles_to_skip--;
+    return false;
 }
 
 void send_to_database(float temperature, float humidity, float pressure, float dew_point, float illumination, float battery_voltage,
     float solar_panel_voltage)
 {
-    HTTPClient http;
-    String url = String(TEST_SERVER_HOST) + ":" + String(TEST_SERVER_PORT) + "/api/weather"
-        + "?temperature=" + String(temperature, 2) + "&dew_point=" + String(dew_point, 2) + "&humidity=" + String(humidity, 1)
-        + "&illumination=" + String(illumination, 1) + "&pressure=" + String(pressure, 2)
-        + "&battery_voltage=" + String(battery_voltage, 2) + "&solar_panel_voltage=" + String(solar_panel_voltage, 2);
+    char buffer[320];
+    PayloadWriter url(buffer, sizeof(buffer));
+    url.append(TEST_SERVER_HOST).append(':').append((uint32_t)TEST_SERVER_PORT).append("/api/weather");
+    url.append("?temperature=").append(temperature, 2).append("&dew_point=").append(dew_point, 2);
+    url.append("&humidity=").append(humidity, 1).append("&illumination=").append(illumination, 1);
+    url.append("&pressure=").append(pressure, 2).append("&battery_voltage=").append(battery_voltage, 2);
+    url.append("&solar_panel_voltage=").append(solar_panel_voltage, 2);
 
-    serial_log("Sending to: " + url);
-    http.begin(url);
+    LOG_INFO("Sending to: %s", url.c_str());
+    HTTPClient http;
+    http.begin(url.c_str());
     int http_code = http.GET();
     if (http_code > 0) {
-        serial_log("Response: " + http.getString());
+        LOG_INFO("Response: %s", http.getString().c_str());
     } else {
-        serial_log("Error on sending request");
+        LOG_ERROR("Error on sending request");
     }
-    delay(10);
+    wait_for(10);
     http.end();
 }
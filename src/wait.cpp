@@ -0,0 +1,46 @@
+#include "wait.h"
+#include "utils.h"
+
+#include <esp_idf_version.h>
+#include <esp_pm.h>
+
+/**
+ * Lowest CPU clock while all tasks are blocked; the APB clock, which I2C, the
+ * UART and WiFi depend on, stays at 80 MHz from here up
+ */
+#define WAIT_MIN_CPU_FREQ_MHZ 80
+
+static void default_sleep_ms(uint32_t ms) { delay(ms); }
+
+static const WaitClock default_clock = { millis, default_sleep_ms };
+static const WaitClock* current_clock = &default_clock;
+
+void wait_begin()
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t config = {};
+#else
+    esp_pm_config_esp32_t config = {};
+#endif
+    config.max_freq_mhz = getCpuFrequencyMhz();
+    config.min_freq_mhz = WAIT_MIN_CPU_FREQ_MHZ;
+    config.light_sleep_enable = true;
+    esp_err_t result = esp_pm_configure(&config);
+    if (result == ESP_ERR_NOT_SUPPORTED) {
+        // the SDK was built without tickless idle, as the stock Arduino-ESP32 libraries are; scale the clock only
+        LOG_INFO("Power management: no light sleep in this SDK build (CONFIG_FREERTOS_USE_TICKLESS_IDLE).");
+        config.light_sleep_enable = false;
+        result = esp_pm_configure(&config);
+    }
+    if (result == ESP_OK)
+        LOG_DEBUG("Power management: %d-%d MHz, light sleep %s.", config.min_freq_mhz, config.max_freq_mhz,
+            config.light_sleep_enable ? "on" : "off");
+    else
+        LOG_WARN("Power management not available (%d) - waiting at full clock.", result);
+}
+
+void wait_set_clock(const WaitClock* clock) { current_clock = clock ? clock : &default_clock; }
+
+const WaitClock& wait_clock() { return *current_clock; }
+
+void wait_for(uint32_t duration_ms) { current_clock->sleep_ms(duration_ms); }
@@ -1,45 +1,71 @@
 #include "wunderground.h"
+#include "clock.h"
 #include "env.h"
 #include "measurement.h"
+#include "payload_writer.h"
 #include "utils.h"
+#include "wait.h"
 
 #include <HTTPClient.h>
 #include <WiFi.h>
 
-void send_to_wunderground(const Measurement& measurement)
+#include <time.h>
+
+/**
+ * Longest URL send_to_wunderground() builds, with the station ID and key from env.h
+ */
+#define WUNDERGROUND_URL_MAX_LENGTH 384
+
+bool send_to_wunderground(const Measurement& measurement, uint32_t timeout_ms)
 {
     if (WiFi.status() == WL_CONNECTED) {
-        String url = "http://weatherstation.wunderground.com/weatherstation/"
-                     "updateweatherstation.php";
-        url += "?ID=" + String(WEATHER_UNDERGROUND_STATION_ID);
-        url += "&PASSWORD=" + String(WEATHER_UNDERGROUND_API_KEY);
-        url += "&dateutc=now";
-        if (measurement.temperature_f)
-            url += "&tempf=" + String(*measurement.temperature_f, 2);
-        if (measurement.dew_point_f)
-            url += "&dewptf=" + String(*measurement.dew_point_f, 2);
-        if (measurement.humidity)
-            url += "&humidity=" + String(*measurement.humidity);
-        if (measurement.pressure_b)
-            url += "&baromin=" + String(*measurement.pressure_b, 2);
-        url += "&action=updateraw";
-
-        Serial.println("Sending data: " + url);
+        char buffer[WUNDERGROUND_URL_MAX_LENGTH];
+        PayloadWriter url(buffer, sizeof(buffer));
+        url.append("http://weatherstation.wunderground.com/weatherstation/"
+                   "updateweatherstation.php");
+        url.append("?ID=" WEATHER_UNDERGROUND_STATION_ID);
+        url.append("&PASSWORD=" WEATHER_UNDERGROUND_API_KEY);
+        if (measurement.timestamp >= VALID_EPOCH) {
+            // "YYYY-MM-DD HH:MM:SS", URL-encoded
+            time_t captured = measurement.timestamp;
+            struct tm utc;
+            char date[32];
+            strftime(date, sizeof(date), "%Y-%m-%d+%H%%3A%M%%3A%S", gmtime_r(&captured, &utc));
+            url.append("&dateutc=").append(date);
+        } else {
+            url.append("&dateutc=now");
+        }
+        for (uint8_t i = 0; i < Measurement::FIELD_COUNT; i++) {
+            const FieldDescriptor& descriptor = field_descriptors[i];
+            if (descriptor.wunderground_name != nullptr && measurement.has((Measurement::Field)i))
+                url.append('&').append(descriptor.wunderground_name).append('=').append(
+                    measurement.get((Measurement::Field)i), descriptor.decimals);
+        }
+        url.append("&action=updateraw");
+
+        if (url.overflowed()) {
+            LOG_ERROR("Weather Underground URL too long - not sending.");
+            return false;
+        }
+
+        LOG_INFO("Sending data: %s", url.c_str());
 
         HTTPClient http;
-        http.begin(url);
+        http.begin(url.c_str());
+        http.setConnectTimeout(timeout_ms);
+        http.setTimeout(timeout_ms);
         int http_code = http.GET();
 
-        if (http_code > 0) {
-            String payload = http.getString();
-            Serial.println("Response: " + payload);
-        } else {
-            Serial.println("Sending error: " + http.errorToString(http_code));
-        }
+        if (http_code > 0)
+            LOG_INFO("Response: %s", http.getString().c_str());
+        else
+            LOG_ERROR("Sending error: %s", HTTPClient::errorToString(http_code).c_str());
 
-        delay(10);
+        wait_for(10);
         http.end();
+        return http_code >= 200 && http_code < 300;
     } else {
-        serial_log("WiFi not connected");
+        LOG_ERROR("WiFi not connected");
+        return false;
     }
 }
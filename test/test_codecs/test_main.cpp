@@ -0,0 +1,322 @@
+/**
+ * Round trips of the encoders on the upload path: the float formatter and
+ * PayloadWriter, gzip against the decoder of the native HAL, the CRCs and the
+ * collector's datagrams
+ *
+ *     pio test -e native -f test_codecs
+ */
+
+#include "collector_packet.h"
+#include "fields.h"
+#include "gzip.h"
+#include "influxdb.h"
+#include "measurement.h"
+#include "payload_writer.h"
+#include "sim.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+void setUp() { }
+
+void tearDown() { }
+
+static const uint8_t check_input[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+static void test_format_fixed_known_values()
+{
+    char out[FORMAT_FIXED_MAX_LENGTH + 1];
+    struct {
+        float value;
+        uint8_t decimals;
+        const char* text;
+    } cases[] = {
+        { 1013.25f, 2, "1013.25" },
+        { 25.3f, 1, "25.3" },
+        { -12.345f, 0, "-12" },
+        { -0.06f, 1, "-0.1" },
+        { -0.04f, 1, "0.0" }, // no negative zero
+        { 0.0f, 3, "0.000" },
+        { 65.2f, 1, "65.2" },
+        { 123456789.0f, 0, "123456792" }, // nearest float
+        { NAN, 2, "nan" },
+        { INFINITY, 2, "inf" },
+    };
+    for (const auto& c : cases) {
+        size_t length = format_fixed(out, c.value, c.decimals);
+        out[length] = '\0';
+        TEST_ASSERT_EQUAL_STRING(c.text, out);
+    }
+}
+
+static void test_format_fixed_parses_back()
+{
+    char out[FORMAT_FIXED_MAX_LENGTH + 1];
+    for (uint8_t decimals = 0; decimals <= 6; decimals++) {
+        double step = pow(10, -decimals);
+        for (int i = -2000; i <= 2000; i++) {
+            float value = i * 0.3719f + (i % 7) * 0.0001f;
+            size_t length = format_fixed(out, value, decimals);
+            TEST_ASSERT_LESS_OR_EQUAL(FORMAT_FIXED_MAX_LENGTH, length);
+            out[length] = '\0';
+            // within half a unit of the last digit, plus the float's own error
+            TEST_ASSERT_FLOAT_WITHIN(step / 2 + fabs(value) * 1e-6, value, strtod(out, nullptr));
+        }
+    }
+}
+
+static void test_payload_writer_truncates()
+{
+    char buffer[16];
+    PayloadWriter writer(buffer, sizeof(buffer));
+    writer.append("weather ").append("temperature=").append(25.3f, 2);
+    TEST_ASSERT_TRUE(writer.overflowed());
+    TEST_ASSERT_EQUAL(sizeof(buffer) - 1, writer.length());
+    TEST_ASSERT_EQUAL(strlen(buffer), writer.length());
+
+    writer.clear();
+    writer.append("t=").append((int32_t)-7).append(',').append((uint32_t)4000000000u);
+    TEST_ASSERT_FALSE(writer.overflowed());
+    TEST_ASSERT_EQUAL_STRING("t=-7,4000000000", buffer);
+}
+
+static void test_line_protocol_at_zero_humidity()
+{
+    // a valid reading, whose dew point is log(0): it has to go, not reach InfluxDB as "nan"
+    Measurement measurement;
+    measurement.timestamp = 1767225600;
+    measurement.set(Measurement::TEMPERATURE_C, 25.0f);
+    measurement.set(Measurement::HUMIDITY, 0.0f);
+    measurement.remove_invalid_measurements();
+    measurement.calculate_derived_values();
+    measurement.remove_invalid_measurements();
+    TEST_ASSERT_TRUE(measurement.has(Measurement::HUMIDITY));
+    TEST_ASSERT_FALSE(measurement.has(Measurement::DEW_POINT_C));
+    TEST_ASSERT_FALSE(measurement.has(Measurement::DEW_POINT_F));
+
+    char buffer[INFLUXDB_LINE_MAX_LENGTH + 1];
+    PayloadWriter line(buffer, sizeof(buffer));
+    write_line_protocol(line, measurement);
+    TEST_ASSERT_EQUAL_STRING("weather temperature=25.00,humidity=0.0 1767225600", line.c_str());
+
+    // whatever else turns up non-finite is dropped as well
+    measurement.set(Measurement::PRESSURE_HPA, NAN);
+    measurement.set(Measurement::ILLUMINATION, INFINITY);
+    measurement.remove_invalid_measurements();
+    TEST_ASSERT_FALSE(measurement.has(Measurement::PRESSURE_HPA));
+    TEST_ASSERT_FALSE(measurement.has(Measurement::ILLUMINATION));
+}
+
+static std::vector<uint8_t> line_protocol(int lines)
+{
+    static char buffer[8192];
+    PayloadWriter payload(buffer, sizeof(buffer));
+    for (int i = 0; i < lines; i++) {
+        if (i > 0)
+            payload.append('\n');
+        payload.append("weather temperature=").append(20.0f + i * 0.1f, 2).append(",humidity=").append(60.0f - i * 0.3f, 1);
+        payload.append(",pressure=").append(1013.25f + i * 0.01f, 2).append(' ').append((uint32_t)(1767225600u + i * 300));
+    }
+    TEST_ASSERT_FALSE(payload.overflowed());
+    return std::vector<uint8_t>(buffer, buffer + payload.length());
+}
+
+static void check_gzip_round_trip(const std::vector<uint8_t>& input)
+{
+    std::vector<uint8_t> compressed(input.size() + input.size() / 8 + 64);
+    size_t length = gzip_compress(input.data(), input.size(), compressed.data(), compressed.size());
+    TEST_ASSERT_GREATER_THAN(0, length);
+
+    std::vector<uint8_t> output;
+    TEST_ASSERT_TRUE(sim::gunzip(compressed.data(), length, output));
+    TEST_ASSERT_EQUAL(input.size(), output.size());
+    if (!input.empty())
+        TEST_ASSERT_EQUAL_MEMORY(input.data(), output.data(), input.size());
+}
+
+static void test_gzip_round_trip_line_protocol()
+{
+    std::vector<uint8_t> input = line_protocol(60);
+    check_gzip_round_trip(input);
+
+    // repeated field names have to pay off
+    std::vector<uint8_t> compressed(input.size());
+    size_t length = gzip_compress(input.data(), input.size(), compressed.data(), compressed.size());
+    TEST_ASSERT_LESS_THAN(input.size() / 2, length);
+}
+
+static void test_gzip_round_trip_edge_cases()
+{
+    check_gzip_round_trip(std::vector<uint8_t>());
+    check_gzip_round_trip(std::vector<uint8_t>(1, 'x'));
+    // one long run, matches overlapping their own output
+    check_gzip_round_trip(std::vector<uint8_t>(5000, 'a'));
+    // repeats farther back than the window are not referenced
+    std::vector<uint8_t> spread;
+    for (int i = 0; i < 3 * GZIP_WINDOW_SIZE; i++)
+        spread.push_back((uint8_t)(i * 7919 >> 3));
+    check_gzip_round_trip(spread);
+    // incompressible
+    std::vector<uint8_t> noise;
+    uint32_t state = 1;
+    for (int i = 0; i < 4000; i++) {
+        state = state * 1103515245 + 12345;
+        noise.push_back(state >> 24);
+    }
+    check_gzip_round_trip(noise);
+}
+
+static void test_gzip_gives_up_when_output_too_small()
+{
+    std::vector<uint8_t> input = line_protocol(20);
+    uint8_t compressed[64];
+    TEST_ASSERT_EQUAL(0, gzip_compress(input.data(), input.size(), compressed, sizeof(compressed)));
+}
+
+static void test_crc_check_values()
+{
+    // the check values of the CRC catalogue, over "123456789"
+    TEST_ASSERT_EQUAL_HEX32(0xcbf43926, crc32_ieee(check_input, sizeof(check_input)));
+    TEST_ASSERT_EQUAL_HEX16(0x29b1, crc16_ccitt(check_input, sizeof(check_input)));
+
+    // the CRC-32 continues across chunks
+    uint32_t crc = crc32_ieee(check_input, 4);
+    TEST_ASSERT_EQUAL_HEX32(0xcbf43926, crc32_ieee(check_input + 4, sizeof(check_input) - 4, crc));
+}
+
+static void test_collector_point_round_trip()
+{
+    CollectorPoint point = {};
+    point.timestamp = 1767225943;
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++) {
+        point.present |= 1u << i;
+        point.values[i] = field_descriptors[i].collector_signed ? -12.34f + i : 12.34f + i * 3;
+    }
+    point.values[3] = 1013.27f; // PRESSURE_HPA, 0.1 hPa resolution
+
+    uint8_t datagram[COLLECTOR_POINT_MAX_LENGTH];
+    size_t length = collector_encode_point(datagram, sizeof(datagram), 42, 0xb007, 65535, COLLECTOR_FLAG_ACK_REQUESTED, point);
+    TEST_ASSERT_GREATER_THAN(0, length);
+
+    CollectorPacket packet;
+    TEST_ASSERT_TRUE(collector_decode(datagram, length, packet));
+    TEST_ASSERT_EQUAL(COLLECTOR_POINT, packet.type);
+    TEST_ASSERT_EQUAL(COLLECTOR_FLAG_ACK_REQUESTED, packet.flags);
+    TEST_ASSERT_EQUAL_UINT32(42, packet.station_id);
+    TEST_ASSERT_EQUAL_UINT16(65535, packet.sequence);
+    TEST_ASSERT_EQUAL_HEX16(0xb007, packet.boot);
+
+    CollectorPoint decoded;
+    TEST_ASSERT_TRUE(collector_decode_point(packet, decoded));
+    TEST_ASSERT_EQUAL_UINT32(point.timestamp, decoded.timestamp);
+    for (uint8_t i = 0; i < COLLECTOR_FIELD_COUNT; i++) {
+        const FieldDescriptor& field = field_descriptors[i];
+        if (field.collector_scale == 0) {
+            // derived fields are left to the collector
+            TEST_ASSERT_FALSE(decoded.present & (1u << i));
+            continue;
+        }
+        TEST_ASSERT_TRUE(decoded.present & (1u << i));
+        TEST_ASSERT_FLOAT_WITHIN(0.5 / field.collector_scale + 1e-4, point.values[i], decoded.values[i]);
+    }
+}
+
+static void test_collector_rejects_corruption()
+{
+    CollectorPoint point = {};
+    point.timestamp = 1;
+    point.present = 1u << 0;
+    point.values[0] = 21.5f;
+    uint8_t datagram[COLLECTOR_POINT_MAX_LENGTH];
+    size_t length = collector_encode_point(datagram, sizeof(datagram), 1, 1, 7, 0, point);
+
+    CollectorPacket packet;
+    for (size_t i = 0; i < length; i++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            datagram[i] ^= 1u << bit;
+            TEST_ASSERT_FALSE(collector_decode(datagram, length, packet));
+            datagram[i] ^= 1u << bit;
+        }
+    }
+    TEST_ASSERT_FALSE(collector_decode(datagram, length - 1, packet));
+    TEST_ASSERT_TRUE(collector_decode(datagram, length, packet));
+}
+
+static void test_collector_ack_and_log_round_trip()
+{
+    uint8_t datagram[64];
+    CollectorPacket packet;
+    size_t length = collector_encode_ack(datagram, sizeof(datagram), 3, 77, 1234);
+    TEST_ASSERT_EQUAL(COLLECTOR_ACK_LENGTH, length);
+    TEST_ASSERT_TRUE(collector_decode(datagram, length, packet));
+    TEST_ASSERT_EQUAL(COLLECTOR_ACK, packet.type);
+    TEST_ASSERT_EQUAL_UINT16(1234, packet.sequence);
+    TEST_ASSERT_EQUAL_UINT16(77, packet.boot);
+    TEST_ASSERT_EQUAL(0, packet.body_length);
+
+    const char text[] = "I Entering deep sleep for 298 seconds...\n";
+    length = collector_encode_log(datagram, sizeof(datagram), 3, 77, 1235, text, strlen(text));
+    TEST_ASSERT_TRUE(collector_decode(datagram, length, packet));
+    TEST_ASSERT_EQUAL(COLLECTOR_LOG, packet.type);
+    TEST_ASSERT_EQUAL(strlen(text), packet.body_length);
+    TEST_ASSERT_EQUAL_MEMORY(text, packet.body, packet.body_length);
+
+    TEST_ASSERT_EQUAL(0, collector_encode_log(datagram, 16, 3, 77, 1236, text, strlen(text)));
+}
+
+static CollectorPacket packet_from(uint32_t station_id, uint16_t boot, uint16_t sequence)
+{
+    CollectorPacket packet = {};
+    packet.type = COLLECTOR_POINT;
+    packet.station_id = station_id;
+    packet.boot = boot;
+    packet.sequence = sequence;
+    return packet;
+}
+
+static void test_collector_drops_retransmissions()
+{
+    CollectorRecent recent = {};
+    TEST_ASSERT_FALSE(collector_seen_recently(recent, packet_from(1, 500, 10)));
+    TEST_ASSERT_FALSE(collector_seen_recently(recent, packet_from(1, 500, 11))); // a log chunk in between
+    TEST_ASSERT_TRUE(collector_seen_recently(recent, packet_from(1, 500, 10)));
+
+    // the window moves on
+    for (uint16_t sequence = 12; sequence < 12 + COLLECTOR_RECENT_SEQUENCES; sequence++)
+        TEST_ASSERT_FALSE(collector_seen_recently(recent, packet_from(1, 500, sequence)));
+    TEST_ASSERT_FALSE(collector_seen_recently(recent, packet_from(1, 500, 10)));
+}
+
+static void test_collector_keeps_points_after_reboot()
+{
+    CollectorRecent recent = {};
+    for (uint16_t sequence = 0; sequence < 5; sequence++)
+        TEST_ASSERT_FALSE(collector_seen_recently(recent, packet_from(1, 500, sequence)));
+
+    // the station lost its RTC memory: sequence 0 again, from another boot
+    TEST_ASSERT_FALSE(collector_seen_recently(recent, packet_from(1, 9001, 0)));
+    TEST_ASSERT_FALSE(collector_seen_recently(recent, packet_from(1, 9001, 1)));
+    TEST_ASSERT_TRUE(collector_seen_recently(recent, packet_from(1, 9001, 0)));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_format_fixed_known_values);
+    RUN_TEST(test_format_fixed_parses_back);
+    RUN_TEST(test_payload_writer_truncates);
+    RUN_TEST(test_line_protocol_at_zero_humidity);
+    RUN_TEST(test_gzip_round_trip_line_protocol);
+    RUN_TEST(test_gzip_round_trip_edge_cases);
+    RUN_TEST(test_gzip_gives_up_when_output_too_small);
+    RUN_TEST(test_crc_check_values);
+    RUN_TEST(test_collector_point_round_trip);
+    RUN_TEST(test_collector_rejects_corruption);
+    RUN_TEST(test_collector_ack_and_log_round_trip);
+    RUN_TEST(test_collector_drops_retransmissions);
+    RUN_TEST(test_collector_keeps_points_after_reboot);
+    return UNITY_END();
+}
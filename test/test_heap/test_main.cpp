@@ -0,0 +1,127 @@
+/**
+ * Allocation budgets of the wake phases (heap_stats.h), checked over simulated
+ * wake cycles of the whole firmware: the sensor path must not touch the heap,
+ * with or without the sensors, the WiFi or the battery
+ *
+ *     pio test -e native -f test_heap
+ */
+
+#include "Arduino.h"
+#include "heap_stats.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <unity.h>
+
+void setup();
+
+/**
+ * A day and a night at 5-minute cycles, with SPS30 measurements and a fan cleaning
+ */
+#define TEST_HEAP_CYCLES 300
+
+static const PerfPhase sensor_phases[] = {
+    PERF_BMP280_BEGIN,
+    PERF_BMP280_READ,
+    PERF_AHT20_BEGIN,
+    PERF_AHT20_READ,
+    PERF_BH1750_BEGIN,
+    PERF_BH1750_READ,
+    PERF_ADS1115_BEGIN,
+    PERF_ADS1115_READ,
+    PERF_SPS30_WARMUP,
+    PERF_SPS30_SAMPLING,
+};
+
+/**
+ * Heap use per phase of the last wake; RTC memory is what the wake's process hands back
+ */
+RTC_DATA_ATTR HeapPhaseStats wake_heap[PERF_PHASE_COUNT];
+
+static void setup_with_heap_stats()
+{
+    try {
+        setup();
+    } catch (...) {
+        // deep sleep or restart
+        for (uint8_t phase = 0; phase < PERF_PHASE_COUNT; phase++)
+            wake_heap[phase] = heap_phase_stats((PerfPhase)phase);
+        throw;
+    }
+}
+
+void setUp() { sim::config() = sim::Config(); }
+
+void tearDown() { }
+
+/**
+ * Runs the cycles and fails on the first phase over its budget
+ *
+ * @param runs Adds how often each phase ran without another task's phase open, in PerfPhase order
+ */
+static void run_cycles(uint32_t runs[PERF_PHASE_COUNT])
+{
+    for (int cycle = 0; cycle < TEST_HEAP_CYCLES; cycle++) {
+        sim::run_wake(setup_with_heap_stats);
+        for (uint8_t i = 0; i < PERF_PHASE_COUNT; i++) {
+            PerfPhase phase = (PerfPhase)i;
+            const HeapPhaseStats& stats = wake_heap[phase];
+            char message[96];
+            snprintf(message, sizeof(message), "cycle %d: %s made %u allocations", cycle, perf_phase_name(phase),
+                stats.own_allocations);
+            TEST_ASSERT_LESS_OR_EQUAL_UINT_MESSAGE(heap_allocation_budget(phase), stats.own_allocations, message);
+            if (runs)
+                runs[phase] += stats.own_runs;
+        }
+    }
+}
+
+static void test_sensor_phases_have_zero_budget()
+{
+    TEST_ASSERT_TRUE_MESSAGE(HEAP_COUNTS_ALLOCATIONS, "the native HAL counts every allocation");
+    for (PerfPhase phase : sensor_phases)
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(0, heap_allocation_budget(phase), perf_phase_name(phase));
+}
+
+static void test_budgets_hold()
+{
+    uint32_t runs[PERF_PHASE_COUNT] = {};
+    run_cycles(runs);
+    // every sensor phase was actually checked
+    for (PerfPhase phase : sensor_phases)
+        TEST_ASSERT_GREATER_THAN_UINT32(0, runs[phase]);
+    TEST_ASSERT_EQUAL_UINT32(TEST_HEAP_CYCLES, runs[PERF_BMP280_READ]);
+}
+
+static void test_budgets_hold_with_missing_sensors()
+{
+    // failed probes log and back off
+    sim::config().bh1750_present = false;
+    sim::config().sps30_present = false;
+    sim::config().bmp280_address = 0x76;
+    run_cycles(nullptr);
+}
+
+static void test_budgets_hold_without_wifi()
+{
+    // connect failures, WiFi backoff and batching in RTC memory
+    sim::config().wifi_available = false;
+    run_cycles(nullptr);
+}
+
+static void test_budgets_hold_on_low_battery()
+{
+    sim::config().battery_voltage = 3.5f;
+    run_cycles(nullptr);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sensor_phases_have_zero_budget);
+    RUN_TEST(test_budgets_hold);
+    RUN_TEST(test_budgets_hold_with_missing_sensors);
+    RUN_TEST(test_budgets_hold_without_wifi);
+    RUN_TEST(test_budgets_hold_on_low_battery);
+    return UNITY_END();
+}
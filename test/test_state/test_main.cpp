@@ -0,0 +1,184 @@
+/**
+ * Decisions kept in RTC memory from cycle to cycle: the deadbands, the power
+ * tiers' hysteresis and the sensor schedule
+ *
+ * The state persists for the whole process, as from one power-on, so each test
+ * walks through its cycles in order.
+ *
+ *     pio test -e native -f test_state
+ */
+
+#include "deadband.h"
+#include "env.h"
+#include "measurement.h"
+#include "power.h"
+#include "schedule.h"
+#include "sim.h"
+#include "utils.h"
+
+#include <unity.h>
+
+extern Measurement deadband_reference;
+extern uint16_t deadband_cycles_since_report;
+
+void setUp() { }
+
+void tearDown() { }
+
+static Measurement voltages(float battery, float solar)
+{
+    Measurement measurement;
+    measurement.set(Measurement::BATTERY_VOLTAGE_A0, battery);
+    measurement.set(Measurement::SOLAR_PANEL_VOLTAGE_A1, solar);
+    return measurement;
+}
+
+static void test_deadband()
+{
+    deadband_reference = Measurement();
+    deadband_cycles_since_report = 0;
+
+    Measurement measurement;
+    measurement.set(Measurement::TEMPERATURE_C, 20.0f);
+    TEST_ASSERT_TRUE(deadband_exceeded(measurement)); // a field that appears
+    deadband_reported(measurement);
+
+    measurement.set(Measurement::TEMPERATURE_C, 20.0f + DEADBAND_TEMPERATURE_C / 2);
+    TEST_ASSERT_FALSE(deadband_exceeded(measurement));
+    measurement.set(Measurement::TEMPERATURE_C, 20.0f - DEADBAND_TEMPERATURE_C * 2);
+    TEST_ASSERT_TRUE(deadband_exceeded(measurement));
+
+    // a field missing this cycle is no change
+    Measurement without_temperature;
+    without_temperature.set(Measurement::HUMIDITY, 50.0f);
+    deadband_reported(without_temperature);
+    TEST_ASSERT_FALSE(deadband_exceeded(without_temperature));
+    TEST_ASSERT_TRUE(deadband_reference.has(Measurement::TEMPERATURE_C));
+
+    // derived fields are not compared
+    without_temperature.set(Measurement::DEW_POINT_C, 99.0f);
+    TEST_ASSERT_FALSE(deadband_exceeded(without_temperature));
+
+    // the heartbeat reports a quiet station every DEADBAND_HEARTBEAT_CYCLES
+    for (int cycle = 1; cycle < DEADBAND_HEARTBEAT_CYCLES; cycle++) {
+        TEST_ASSERT_FALSE(deadband_exceeded(without_temperature));
+        deadband_skipped();
+    }
+    TEST_ASSERT_TRUE(deadband_exceeded(without_temperature));
+}
+
+/**
+ * Feeds the same voltages until the smoothed battery voltage has settled; the
+ * readings are further apart than the trend looks, so there is no trend
+ */
+static PowerTier settle(float battery, float solar)
+{
+    for (int i = 0; i < 40; i++) {
+        sim::advance_us(7ull * 3600 * 1000000);
+        power_update(voltages(battery, solar));
+    }
+    return power_plan().tier;
+}
+
+static void test_power_tier_hysteresis()
+{
+    TEST_ASSERT_EQUAL(POWER_NORMAL, settle(POWER_ECONOMY_BELOW_V + 0.2f, 0));
+    TEST_ASSERT_TRUE(power_plan().particulate_matter);
+
+    TEST_ASSERT_EQUAL(POWER_ECONOMY, settle(POWER_ECONOMY_BELOW_V - 0.02f, 0));
+    TEST_ASSERT_FALSE(power_plan().particulate_matter);
+    TEST_ASSERT_EQUAL_UINT32(CYCLE_TIME_SEC * POWER_ECONOMY_CYCLE_FACTOR, power_plan().cycle_time_s);
+
+    // back above the threshold, but within the hysteresis
+    TEST_ASSERT_EQUAL(POWER_ECONOMY, settle(POWER_ECONOMY_BELOW_V + POWER_HYSTERESIS_V / 2, 0));
+    // the same voltage suffices while the sun charges the battery
+    TEST_ASSERT_EQUAL(POWER_NORMAL, settle(POWER_ECONOMY_BELOW_V + POWER_HYSTERESIS_V / 2, POWER_SOLAR_CHARGING_V + 0.5f));
+
+    TEST_ASSERT_EQUAL(POWER_CRITICAL, settle(POWER_CRITICAL_BELOW_V - 0.02f, 0));
+    TEST_ASSERT_FALSE(power_plan().radio);
+    TEST_ASSERT_EQUAL(POWER_CRITICAL, settle(POWER_CRITICAL_BELOW_V + POWER_HYSTERESIS_V / 2, 0));
+    TEST_ASSERT_EQUAL(POWER_ECONOMY, settle(POWER_CRITICAL_BELOW_V + POWER_HYSTERESIS_V * 1.5f, 0));
+    TEST_ASSERT_EQUAL(POWER_NORMAL, settle(POWER_ECONOMY_BELOW_V + POWER_HYSTERESIS_V * 1.5f, 0));
+}
+
+static void test_power_trend_steps_down_early()
+{
+    TEST_ASSERT_EQUAL(POWER_NORMAL, settle(POWER_ECONOMY_BELOW_V + 0.15f, 0));
+
+    // still above the threshold, but falling fast enough to get below it within POWER_TREND_HORIZON_H
+    float battery = POWER_ECONOMY_BELOW_V + 0.15f;
+    for (int i = 0; i < 24 && power_plan().tier == POWER_NORMAL; i++) {
+        sim::advance_us(600ull * 1000000);
+        battery -= 0.005f;
+        power_update(voltages(battery, 0));
+    }
+    TEST_ASSERT_EQUAL(POWER_ECONOMY, power_plan().tier);
+    TEST_ASSERT_GREATER_THAN(POWER_ECONOMY_BELOW_V, battery);
+}
+
+static const PowerPlan full_power = { POWER_NORMAL, CYCLE_TIME_SEC, 1, true, true };
+static const PowerPlan economy = { POWER_ECONOMY, CYCLE_TIME_SEC * POWER_ECONOMY_CYCLE_FACTOR, 4, false, true };
+
+static void test_schedule_due_times()
+{
+    // power-on: every job is due on its first cycle
+    schedule_begin_cycle(full_power);
+    for (uint8_t job = 0; job < JOB_COUNT; job++)
+        TEST_ASSERT_TRUE(schedule_due((Job)job));
+    for (uint8_t job = 0; job < JOB_COUNT; job++)
+        schedule_done((Job)job);
+
+    // the SPS30 every SPS30_MEASUREMENT_INTERVAL_CYCLES, the others every cycle
+    for (int cycle = 1; cycle < SPS30_MEASUREMENT_INTERVAL_CYCLES; cycle++) {
+        schedule_begin_cycle(full_power);
+        TEST_ASSERT_TRUE(schedule_due(JOB_BMP280));
+        schedule_done(JOB_BMP280);
+        TEST_ASSERT_FALSE(schedule_due(JOB_SPS30));
+        TEST_ASSERT_FALSE(schedule_due(JOB_SPS30_CLEANING));
+    }
+
+    // due, but held back in economy, and run on the first cycle at full power
+    schedule_begin_cycle(economy);
+    TEST_ASSERT_FALSE(schedule_due(JOB_SPS30));
+    schedule_begin_cycle(full_power);
+    TEST_ASSERT_TRUE(schedule_due(JOB_SPS30));
+    schedule_done(JOB_SPS30);
+    schedule_begin_cycle(full_power);
+    TEST_ASSERT_FALSE(schedule_due(JOB_SPS30));
+}
+
+static void test_schedule_daylight()
+{
+    schedule_begin_cycle(full_power);
+    TEST_ASSERT_TRUE(schedule_due(JOB_BH1750));
+    TEST_ASSERT_TRUE(schedule_due(JOB_UV));
+
+    // night from the next cycle on
+    schedule_update(voltages(3.9f, SCHEDULE_DAYLIGHT_SOLAR_V / 2));
+    schedule_begin_cycle(full_power);
+    TEST_ASSERT_FALSE(schedule_due(JOB_BH1750));
+    TEST_ASSERT_FALSE(schedule_due(JOB_UV));
+    TEST_ASSERT_TRUE(schedule_due(JOB_AHT20));
+
+    // without a solar panel voltage, nothing is held back
+    Measurement no_ads1115;
+    schedule_update(no_ads1115);
+    schedule_begin_cycle(full_power);
+    TEST_ASSERT_TRUE(schedule_due(JOB_BH1750));
+
+    schedule_update(voltages(3.9f, SCHEDULE_DAYLIGHT_SOLAR_V + 1));
+    schedule_begin_cycle(full_power);
+    TEST_ASSERT_TRUE(schedule_due(JOB_UV));
+}
+
+int main()
+{
+    log_begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_deadband);
+    RUN_TEST(test_power_tier_hysteresis);
+    RUN_TEST(test_power_trend_steps_down_early);
+    RUN_TEST(test_schedule_due_times);
+    RUN_TEST(test_schedule_daylight);
+    return UNITY_END();
+}
@@ -0,0 +1,133 @@
+/**
+ * wait_for() and wait_until() on a fake WaitClock: timeouts, early returns and
+ * the poll interval, without any time passing
+ *
+ *     pio test -e native -f test_wait
+ */
+
+#include "sim.h"
+#include "wait.h"
+
+#include <chrono>
+#include <unity.h>
+#include <vector>
+
+static unsigned long fake_now = 0;
+static std::vector<uint32_t> sleeps;
+
+static unsigned long fake_now_ms() { return fake_now; }
+
+static void fake_sleep_ms(uint32_t ms)
+{
+    sleeps.push_back(ms);
+    fake_now += ms;
+}
+
+static const WaitClock fake_clock = { fake_now_ms, fake_sleep_ms };
+
+void setUp()
+{
+    fake_now = 1000;
+    sleeps.clear();
+    wait_set_clock(&fake_clock);
+}
+
+void tearDown() { wait_set_clock(nullptr); }
+
+static uint32_t slept_ms()
+{
+    uint32_t total = 0;
+    for (uint32_t ms : sleeps)
+        total += ms;
+    return total;
+}
+
+static void test_wait_for_sleeps_once()
+{
+    wait_for(16000);
+    TEST_ASSERT_EQUAL(1, sleeps.size());
+    TEST_ASSERT_EQUAL_UINT32(16000, sleeps[0]);
+    TEST_ASSERT_EQUAL_UINT32(17000, fake_now);
+}
+
+static void test_wait_until_times_out()
+{
+    int checks = 0;
+    TEST_ASSERT_FALSE(wait_until([&]() { return ++checks < 0; }, 1000));
+    // not a millisecond more than the timeout
+    TEST_ASSERT_EQUAL_UINT32(1000, slept_ms());
+    TEST_ASSERT_EQUAL(1000 / WAIT_POLL_MS + 1, checks);
+}
+
+static void test_wait_until_zero_timeout_checks_once()
+{
+    int checks = 0;
+    TEST_ASSERT_FALSE(wait_until([&]() { return ++checks < 0; }, 0));
+    TEST_ASSERT_EQUAL(1, checks);
+    TEST_ASSERT_EQUAL(0, sleeps.size());
+}
+
+static void test_wait_until_returns_when_condition_met()
+{
+    TEST_ASSERT_TRUE(wait_until([]() { return true; }, 5000));
+    TEST_ASSERT_EQUAL(0, sleeps.size());
+
+    unsigned long ready_at = fake_now + 300;
+    TEST_ASSERT_TRUE(wait_until([&]() { return fake_now >= ready_at; }, 5000));
+    TEST_ASSERT_EQUAL_UINT32(300, slept_ms());
+}
+
+static void test_wait_until_polls_at_interval()
+{
+    TEST_ASSERT_FALSE(wait_until([]() { return false; }, 1010, 100));
+    TEST_ASSERT_EQUAL(11, sleeps.size());
+    for (size_t i = 0; i + 1 < sleeps.size(); i++)
+        TEST_ASSERT_EQUAL_UINT32(100, sleeps[i]);
+    // the last sleep ends at the timeout
+    TEST_ASSERT_EQUAL_UINT32(10, sleeps.back());
+}
+
+static void test_wait_until_handles_clock_wrap()
+{
+    fake_now = (unsigned long)-50;
+    TEST_ASSERT_FALSE(wait_until([]() { return false; }, 200));
+    TEST_ASSERT_EQUAL_UINT32(200, slept_ms());
+}
+
+static void test_no_time_passes()
+{
+    uint64_t virtual_start = sim::now_us();
+    auto real_start = std::chrono::steady_clock::now();
+
+    wait_for(3600000);
+    TEST_ASSERT_FALSE(wait_until([]() { return false; }, 3600000));
+
+    auto real_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - real_start).count();
+    TEST_ASSERT_LESS_THAN(1000, real_ms);
+    // delay() was not called either: the native HAL's virtual clock stood still
+    TEST_ASSERT_EQUAL(virtual_start, sim::now_us());
+    TEST_ASSERT_EQUAL_UINT32(7200000, slept_ms());
+}
+
+static void test_default_clock_restored()
+{
+    wait_set_clock(nullptr);
+    uint64_t start = sim::now_us();
+    wait_for(250);
+    TEST_ASSERT_EQUAL(0, sleeps.size());
+    TEST_ASSERT_EQUAL(250000, sim::now_us() - start);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_wait_for_sleeps_once);
+    RUN_TEST(test_wait_until_times_out);
+    RUN_TEST(test_wait_until_zero_timeout_checks_once);
+    RUN_TEST(test_wait_until_returns_when_condition_met);
+    RUN_TEST(test_wait_until_polls_at_interval);
+    RUN_TEST(test_wait_until_handles_clock_wrap);
+    RUN_TEST(test_no_time_passes);
+    RUN_TEST(test_default_clock_restored);
+    return UNITY_END();
+}
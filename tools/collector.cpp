@@ -0,0 +1,105 @@
+/**
+ * Local collector for the binary UDP transport
+ *
+ * Receives the datagrams of stations with SEND_TO_COLLECTOR or LOG_TO_COLLECTOR
+ * enabled (format in include/collector_packet.h), acknowledges them when asked
+ * and prints every point once as InfluxDB line protocol on stdout, e.g.
+ *     .pio/build/collector/program | influx write --bucket weather
+ * Log text is written to stderr, prefixed with the station ID.
+ *
+ * Points from stations whose clock is not synchronized yet are stamped with the
+ * arrival time.
+ *
+ * Build and run with PlatformIO:
+ *     pio run -e collector && .pio/build/collector/program [-p PORT]
+ * or directly:
+ *     g++ -std=gnu++14 -O2 -Iinclude src/payload_writer.cpp src/collector_packet.cpp tools/collector.cpp -o collector
+ */
+
+#include "collector_packet.h"
+#include "payload_writer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+
+// the same limit as VALID_EPOCH in include/clock.h
+static const uint32_t valid_epoch = 1700000000;
+
+int main(int argc, char** argv)
+{
+    uint16_t port = 4950;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = (uint16_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-p PORT]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        perror("collector: bind");
+        return 1;
+    }
+    fprintf(stderr, "collector: listening on UDP port %u\n", port);
+
+    std::map<uint32_t, CollectorRecent> stations;
+    uint8_t datagram[2048];
+    char line_buffer[512];
+
+    for (;;) {
+        sockaddr_in sender = {};
+        socklen_t sender_length = sizeof(sender);
+        ssize_t length = recvfrom(fd, datagram, sizeof(datagram), 0, reinterpret_cast<sockaddr*>(&sender), &sender_length);
+        if (length < 0) {
+            perror("collector: recvfrom");
+            continue;
+        }
+
+        CollectorPacket packet;
+        if (!collector_decode(datagram, (size_t)length, packet)) {
+            fprintf(stderr, "collector: dropped malformed datagram of %zd bytes from %s\n", length, inet_ntoa(sender.sin_addr));
+            continue;
+        }
+
+        if (packet.flags & COLLECTOR_FLAG_ACK_REQUESTED) {
+            uint8_t ack[COLLECTOR_ACK_LENGTH];
+            size_t ack_length = collector_encode_ack(ack, sizeof(ack), packet.station_id, packet.boot, packet.sequence);
+            sendto(fd, ack, ack_length, 0, reinterpret_cast<sockaddr*>(&sender), sender_length);
+        }
+
+        if (collector_seen_recently(stations[packet.station_id], packet))
+            continue;
+
+        if (packet.type == COLLECTOR_LOG) {
+            fprintf(stderr, "[station %u] %.*s", packet.station_id, (int)packet.body_length, (const char*)packet.body);
+            continue;
+        }
+
+        CollectorPoint point;
+        if (packet.type != COLLECTOR_POINT || !collector_decode_point(packet, point)) {
+            fprintf(stderr, "collector: unexpected datagram type %u from station %u\n", packet.type, packet.station_id);
+            continue;
+        }
+        if (point.timestamp < valid_epoch)
+            point.timestamp = (uint32_t)time(nullptr);
+
+        PayloadWriter line(line_buffer, sizeof(line_buffer));
+        collector_write_line_protocol(line, packet.station_id, point);
+        printf("%s\n", line.c_str());
+        fflush(stdout);
+    }
+}
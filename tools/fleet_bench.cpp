@@ -0,0 +1,373 @@
+/**
+ * Host-side load test of a fleet of stations against one local collector
+ *
+ * Runs N instances of the firmware against the mocks in lib/native_hal, each with
+ * its own RTC memory, clock and LittleFS directory, and plays a single local
+ * server for all of them: the InfluxDB write and Weather Underground endpoints
+ * over HTTP and the binary UDP collector. The server handles as many requests at
+ * a time as it has workers, each taking a fixed time plus a time per kB of
+ * request; requests that find the queue full are answered with 503 right away.
+ * For each fleet size it reports the server's throughput, response time
+ * percentiles and rejected requests, and per station the radio-on time and the
+ * points written.
+ *
+ * Wake cycles are simulated one at a time, in the order in which they start, so a
+ * request can queue behind one that arrives a little later in another station's
+ * cycle. The server places every request in the first gap of a worker after its
+ * arrival, which keeps that error small. The log upload to LOG_SERVER_HOST is
+ * not modelled; with LOG_TO_COLLECTOR it goes out as datagrams, which are.
+ *
+ * The firmware is built with the project's include/env.h.
+ *
+ * Build and run with PlatformIO:
+ *     pio run -e fleet_bench && .pio/build/fleet_bench/program [options]
+ *
+ * Options:
+ *     --stations N,N,...  fleet sizes to run (default 1,8,32,64)
+ *     --hours H           simulated time per run (default 24)
+ *     --spread S          first wakes spread evenly over S seconds (default CYCLE_TIME_SEC); 0: all at once
+ *     --workers W         requests the server handles at a time (default 4)
+ *     --queue Q           requests that may wait for a worker; more are rejected (default 16)
+ *     --service-ms MS     server time per request (default 20)
+ *     --ms-per-kb MS      server time per kB of request (default 2)
+ */
+
+#include "collector_packet.h"
+#include "env.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <pthread.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [--stations N,N,...] [--hours H] [--spread S] [--workers W] [--queue Q] [--service-ms MS] [--ms-per-kb MS]\n",
+        program);
+    exit(2);
+}
+
+enum Endpoint : uint8_t { ENDPOINT_INFLUXDB, ENDPOINT_WUNDERGROUND, ENDPOINT_OTHER, ENDPOINT_COUNT };
+
+struct Interval {
+    uint64_t from_us;
+    uint64_t to_us;
+};
+
+struct RequestRecord {
+    uint64_t arrival_us; // on the station clocks, which all count from the same power-on
+    uint32_t response_us;
+    Endpoint endpoint;
+    bool rejected;
+};
+
+constexpr uint32_t kMaxWorkers = 64;
+constexpr size_t kMaxBusy = 1 << 14; // per worker, within kHorizonUs
+constexpr size_t kMaxWaiting = 1 << 12;
+constexpr uint64_t kHorizonUs = 600 * 1000000ull; // longer than any wake cycle
+constexpr uint32_t kRejectUs = 1000;
+
+/**
+ * State of the stand-in server, in memory shared with the forked wake cycles
+ */
+struct Server {
+    pthread_mutex_t lock; // upload tasks of a wake call in concurrently
+    uint32_t workers;
+    uint32_t queue_limit;
+    double service_us;
+    double us_per_byte;
+
+    uint32_t busy_count[kMaxWorkers];
+    Interval busy[kMaxWorkers][kMaxBusy]; // unordered
+    uint32_t waiting_count;
+    Interval waiting[kMaxWaiting]; // accepted requests between arrival and start
+
+    uint64_t datagrams;
+    uint64_t acks;
+    size_t record_capacity;
+    size_t record_count;
+    RequestRecord records[]; // record_capacity of them
+};
+
+static Server* server = nullptr;
+static size_t server_size = 0;
+
+/**
+ * Earliest start at or after `arrival_us` at which `worker` is free for `service_us`
+ */
+static uint64_t earliest_start(uint32_t worker, uint64_t arrival_us, uint64_t service_us)
+{
+    uint64_t start = arrival_us;
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        for (uint32_t i = 0; i < server->busy_count[worker]; i++) {
+            const Interval& busy = server->busy[worker][i];
+            if (busy.from_us < start + service_us && busy.to_us > start) {
+                start = busy.to_us;
+                moved = true;
+            }
+        }
+    }
+    return start;
+}
+
+/**
+ * Drops what ended before the horizon, so the arrays only hold the recent past
+ */
+static void prune(uint64_t now_us)
+{
+    uint64_t cutoff = now_us > kHorizonUs ? now_us - kHorizonUs : 0;
+    for (uint32_t worker = 0; worker < server->workers; worker++) {
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < server->busy_count[worker]; i++)
+            if (server->busy[worker][i].to_us >= cutoff)
+                server->busy[worker][kept++] = server->busy[worker][i];
+        server->busy_count[worker] = kept;
+    }
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < server->waiting_count; i++)
+        if (server->waiting[i].to_us >= cutoff)
+            server->waiting[kept++] = server->waiting[i];
+    server->waiting_count = kept;
+}
+
+static int http_responder(const char* url, size_t request_bytes, uint32_t* response_ms)
+{
+    Endpoint endpoint = strstr(url, "/api/v2/write")  ? ENDPOINT_INFLUXDB
+        : strstr(url, "/weatherstation/")              ? ENDPOINT_WUNDERGROUND
+                                                        : ENDPOINT_OTHER;
+    uint64_t arrival_us = sim::now_us();
+    uint64_t service_us = (uint64_t)(server->service_us + server->us_per_byte * request_bytes);
+
+    pthread_mutex_lock(&server->lock);
+    prune(arrival_us);
+    uint32_t waiting = 0;
+    for (uint32_t i = 0; i < server->waiting_count; i++)
+        if (server->waiting[i].from_us <= arrival_us && server->waiting[i].to_us > arrival_us)
+            waiting++;
+
+    uint32_t worker = 0;
+    uint64_t start_us = UINT64_MAX;
+    for (uint32_t i = 0; i < server->workers; i++) {
+        uint64_t start = earliest_start(i, arrival_us, service_us);
+        if (start < start_us) {
+            start_us = start;
+            worker = i;
+        }
+    }
+
+    bool rejected = start_us > arrival_us && (waiting >= server->queue_limit || server->waiting_count == kMaxWaiting);
+    if (!rejected && server->busy_count[worker] == kMaxBusy) {
+        fprintf(stderr, "fleet_bench: more than %zu requests per worker in %llu s\n", kMaxBusy,
+            (unsigned long long)(kHorizonUs / 1000000));
+        abort();
+    }
+    uint32_t response_us = rejected ? kRejectUs : (uint32_t)(start_us + service_us - arrival_us);
+    if (!rejected) {
+        server->busy[worker][server->busy_count[worker]++] = { start_us, start_us + service_us };
+        if (start_us > arrival_us)
+            server->waiting[server->waiting_count++] = { arrival_us, start_us };
+    }
+    if (server->record_count < server->record_capacity)
+        server->records[server->record_count++] = { arrival_us, response_us, endpoint, rejected };
+    pthread_mutex_unlock(&server->lock);
+
+    *response_ms = (response_us + 999) / 1000;
+    return rejected ? 503 : endpoint == ENDPOINT_WUNDERGROUND ? 200 : 204;
+}
+
+/**
+ * Acknowledges every valid datagram that asks for it, like tools/collector.cpp
+ */
+static size_t collector_responder(const uint8_t* datagram, size_t length, uint8_t* reply, size_t capacity)
+{
+    CollectorPacket packet;
+    bool valid = collector_decode(datagram, length, packet);
+    pthread_mutex_lock(&server->lock);
+    server->datagrams++;
+    bool ack = valid && (packet.flags & COLLECTOR_FLAG_ACK_REQUESTED);
+    server->acks += ack;
+    pthread_mutex_unlock(&server->lock);
+    return ack ? collector_encode_ack(reply, capacity, packet.station_id, packet.boot, packet.sequence) : 0;
+}
+
+static void reset_server(uint32_t workers, uint32_t queue_limit, double service_ms, double ms_per_kb, size_t record_capacity)
+{
+    if (server)
+        munmap(server, server_size);
+    server_size = sizeof(Server) + record_capacity * sizeof(RequestRecord);
+    void* memory = mmap(nullptr, server_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        perror("fleet_bench: mmap");
+        exit(1);
+    }
+    server = static_cast<Server*>(memory); // zero-filled
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&server->lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    server->workers = workers;
+    server->queue_limit = queue_limit;
+    server->service_us = service_ms * 1000;
+    server->us_per_byte = ms_per_kb * 1000 / 1024;
+    server->record_capacity = record_capacity;
+}
+
+static void remove_directory(const char* path)
+{
+    DIR* directory = opendir(path);
+    while (dirent* entry = directory ? readdir(directory) : nullptr)
+        if (entry->d_name[0] != '.')
+            unlink((std::string(path) + "/" + entry->d_name).c_str());
+    if (directory)
+        closedir(directory);
+    rmdir(path);
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(fraction * (values.size() - 1) + 0.5)];
+}
+
+struct FleetStation {
+    sim::Station state;
+    std::string flash_dir;
+    double radio_on_s = 0;
+    uint64_t points_written = 0;
+    uint32_t wakes = 0;
+};
+
+static void run_fleet(int stations, double hours, double spread_s)
+{
+    uint64_t end_us = (uint64_t)(hours * 3600e6);
+    std::vector<FleetStation> fleet(stations);
+    for (int i = 0; i < stations; i++) {
+        char flash_dir[] = "/tmp/fleet_bench.XXXXXX";
+        if (!mkdtemp(flash_dir)) {
+            perror("fleet_bench: mkdtemp");
+            exit(1);
+        }
+        fleet[i].flash_dir = flash_dir;
+        fleet[i].state.time_us = (uint64_t)(spread_s * 1e6 * i / stations);
+    }
+
+    // the station whose next wake comes first runs next
+    for (;;) {
+        FleetStation* next = nullptr;
+        for (FleetStation& station : fleet)
+            if (station.state.time_us < end_us && (!next || station.state.time_us < next->state.time_us))
+                next = &station;
+        if (!next)
+            break;
+
+        sim::Config& config = sim::config();
+        config.flash_dir = next->flash_dir.c_str();
+        config.seed = (uint32_t)(next - fleet.data()) + 1;
+        sim::swap_station(next->state);
+        sim::WakeStats stats = sim::run_wake(setup);
+        sim::swap_station(next->state);
+
+        next->radio_on_s += stats.radio_on_us / 1e6;
+        next->points_written += stats.points_written;
+        next->wakes++;
+    }
+
+    std::vector<double> response_ms;
+    uint64_t per_endpoint[ENDPOINT_COUNT] = {};
+    uint64_t rejected = 0;
+    std::vector<uint32_t> per_second((size_t)(hours * 3600) + 600, 0);
+    for (size_t i = 0; i < server->record_count; i++) {
+        const RequestRecord& record = server->records[i];
+        per_endpoint[record.endpoint]++;
+        if (record.rejected) {
+            rejected++;
+            continue;
+        }
+        response_ms.push_back(record.response_us / 1e3);
+        size_t second = std::min(per_second.size() - 1, (size_t)(record.arrival_us / 1000000));
+        per_second[second]++;
+    }
+    if (server->record_count == server->record_capacity)
+        fprintf(stderr, "fleet_bench: only the first %zu requests were recorded\n", server->record_capacity);
+
+    double days = hours / 24;
+    std::vector<double> radio_s_per_day, points_per_day;
+    for (FleetStation& station : fleet) {
+        radio_s_per_day.push_back(station.radio_on_s / days);
+        points_per_day.push_back(station.points_written / days);
+        remove_directory(station.flash_dir.c_str());
+    }
+
+    printf("%8d %8llu %8llu %8.1f %7u %8.1f %8.1f %8.1f %8.1f %9llu %10llu %9.1f %9.1f %9.1f\n", stations,
+        (unsigned long long)per_endpoint[ENDPOINT_INFLUXDB], (unsigned long long)per_endpoint[ENDPOINT_WUNDERGROUND],
+        response_ms.size() / (hours * 60), *std::max_element(per_second.begin(), per_second.end()),
+        percentile(response_ms, 0.5), percentile(response_ms, 0.95), percentile(response_ms, 0.99),
+        percentile(response_ms, 1.0), (unsigned long long)rejected, (unsigned long long)server->datagrams,
+        percentile(radio_s_per_day, 0.5), percentile(radio_s_per_day, 1.0), percentile(points_per_day, 0.5));
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> fleet_sizes = { 1, 8, 32, 64 };
+    double hours = 24;
+    double spread_s = CYCLE_TIME_SEC;
+    uint32_t workers = 4, queue_limit = 16;
+    double service_ms = 20, ms_per_kb = 2;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--stations") == 0 && has_value) {
+            fleet_sizes.clear();
+            for (char* size = strtok(argv[++i], ","); size; size = strtok(nullptr, ","))
+                fleet_sizes.push_back(atoi(size));
+        } else if (strcmp(argv[i], "--hours") == 0 && has_value)
+            hours = atof(argv[++i]);
+        else if (strcmp(argv[i], "--spread") == 0 && has_value)
+            spread_s = atof(argv[++i]);
+        else if (strcmp(argv[i], "--workers") == 0 && has_value)
+            workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--queue") == 0 && has_value)
+            queue_limit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--service-ms") == 0 && has_value)
+            service_ms = atof(argv[++i]);
+        else if (strcmp(argv[i], "--ms-per-kb") == 0 && has_value)
+            ms_per_kb = atof(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (hours <= 0 || spread_s < 0 || workers < 1 || workers > kMaxWorkers || fleet_sizes.empty())
+        usage(argv[0]);
+    for (int size : fleet_sizes)
+        if (size < 1)
+            usage(argv[0]);
+
+    sim::Config& config = sim::config();
+    config.http_responder = http_responder;
+    config.udp_responder = collector_responder;
+
+    printf("server: %u workers, queue of %u, %.1f ms + %.1f ms/kB per request; %.1f h, first wakes over %.0f s\n", workers,
+        queue_limit, service_ms, ms_per_kb, hours, spread_s);
+    printf("            HTTP requests   served             response time [ms]                         radio-on [s/day]  points/day\n");
+    printf("stations   influxdb       WU    1/min  peak/s      p50      p95      p99      max  rejected  datagrams       p50       max       p50\n");
+    for (int size : fleet_sizes) {
+        // a generous bound on the requests of a run: a few per wake, wakes every CYCLE_TIME_SEC at most
+        size_t record_capacity = (size_t)size * (size_t)(hours * 3600 / 60 + 1) * 8;
+        reset_server(workers, queue_limit, service_ms, ms_per_kb, record_capacity);
+        run_fleet(size, hours, spread_s);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * Host-side benchmark of the gzip encoder on InfluxDB payloads
+ *
+ * Builds line protocol payloads as the firmware sends them (one "weather" line per
+ * point, 5 minutes apart, with slowly changing values, and a firmware_perf line per
+ * 4 points) and reports for each size: the compression ratio, the CPU time of
+ * gzip_compress() and the airtime the saved bytes would have cost at typical rates
+ * of a station with a weak signal. The ESP32 runs the encoder an order of magnitude
+ * slower than a desktop CPU, which still leaves the CPU time well below the airtime
+ * saved.
+ *
+ * Build and run with PlatformIO:
+ *     pio run -e gzip_bench && .pio/build/gzip_bench/program
+ * or directly:
+ *     g++ -std=gnu++14 -O2 -Iinclude src/payload_writer.cpp src/gzip.cpp tools/gzip_bench.cpp -o gzip_bench
+ */
+
+#include "gzip.h"
+#include "payload_writer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static const char* const names[11] = { "temperature", "dew_point", "humidity", "pressure", "illumination", "battery_voltage",
+    "solar_panel_voltage", "uv_voltage", "mc_pm1_0", "mc_pm2_5", "mc_pm10_0" };
+static const uint8_t decimals[11] = { 2, 2, 1, 2, 1, 2, 2, 2, 2, 2, 2 };
+
+static const char* const perf_names[8] = { "boot_us", "bmp280_read_us", "aht20_read_us", "bh1750_read_us", "ads1115_read_us",
+    "wifi_connect_us", "influxdb_us", "active_us" };
+
+static size_t build_payload(char* buffer, size_t capacity, int points, std::mt19937& random)
+{
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    PayloadWriter payload(buffer, capacity);
+    uint32_t timestamp = 1767225600;
+    for (int point = 0; point < points; point++, timestamp += 300) {
+        float hours = point / 12.0f;
+        float values[11] = { 12 + 8 * sinf(hours / 3.8f) + 0.05f * noise(random), 6 + 0.1f * noise(random),
+            70 - 20 * sinf(hours / 3.8f) + 0.3f * noise(random), 1013.25f + hours * 0.2f + 0.02f * noise(random),
+            30000 + 20000 * sinf(hours / 3.8f) + 5 * noise(random), 3.95f - hours * 0.002f, 5.2f + 0.01f * noise(random),
+            0.6f + 0.01f * noise(random), 6 + 0.5f * noise(random), 9 + 0.5f * noise(random), 12 + 0.5f * noise(random) };
+        if (payload.length() > 0)
+            payload.append('\n');
+        payload.append("weather ");
+        for (int i = 0; i < 11; i++) {
+            if (i > 0)
+                payload.append(',');
+            payload.append(names[i]).append('=').append(values[i], decimals[i]);
+        }
+        payload.append(' ').append(timestamp);
+
+        if (point % 4 == 3) {
+            payload.append("\nfirmware_perf ");
+            for (int i = 0; i < 8; i++)
+                payload.append(perf_names[i]).append('=').append((uint32_t)(50000 + random() % 400000)).append("i,");
+            payload.append("free_heap=").append((uint32_t)(230000 + random() % 2000)).append("i ").append(timestamp);
+        }
+    }
+    return payload.length();
+}
+
+int main()
+{
+    static char payload[65536];
+    static uint8_t compressed[65536];
+    std::mt19937 random(42);
+
+    printf("points   raw [B]  gzip [B]  ratio  CPU [us]  saved [B]  airtime saved [ms] at 1 Mbit/s / 250 kbit/s\n");
+    for (int points : { 1, 4, 8, 12, 24, 32, 96 }) {
+        size_t length = build_payload(payload, sizeof(payload), points, random);
+
+        size_t compressed_length = 0;
+        int runs = 2000 / points + 20;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; run++)
+            compressed_length = gzip_compress((const uint8_t*)payload, length, compressed, sizeof(compressed));
+        double cpu_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+
+        long saved = (long)length - (long)compressed_length;
+        printf("%6d  %8zu  %8zu  %5.2f  %8.1f  %9ld  %8.2f / %6.2f\n", points, length, compressed_length,
+            (double)length / compressed_length, cpu_us, saved, saved * 8 / 1000.0, saved * 8 / 250.0);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * Host-side micro-benchmark of the payload builder
+ *
+ * Compares format_fixed() with printf-style formatting, and building a full
+ * InfluxDB line with PayloadWriter against the String concatenation chain it
+ * replaced. The String path is modelled with std::string: every
+ * "name=" + String(value, n) + "," step creates the same temporaries, and
+ * String(value, n) formats through printf on the ESP32 as well.
+ *
+ * Build and run with PlatformIO:
+ *     pio run -e payload_bench && .pio/build/payload_bench/program
+ * or directly:
+ *     g++ -std=gnu++14 -O2 -Iinclude src/payload_writer.cpp tools/payload_bench.cpp -o payload_bench
+ */
+
+#include "payload_writer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if (void* pointer = malloc(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+
+struct Point {
+    float values[11];
+};
+
+static const char* const names[11] = { "temperature", "dew_point", "humidity", "pressure", "illumination", "battery_voltage",
+    "solar_panel_voltage", "uv_voltage", "mc_pm1_0", "mc_pm2_5", "mc_pm10_0" };
+static const uint8_t decimals[11] = { 2, 2, 1, 2, 1, 2, 2, 2, 2, 2, 2 };
+
+static std::string string_from_float(float value, unsigned int places)
+{
+    char text[40];
+    snprintf(text, sizeof(text), "%.*f", places, value);
+    return std::string(text);
+}
+
+static std::string build_with_strings(const Point& point)
+{
+    std::string payload = std::string("weather ");
+    for (int i = 0; i < 11; i++)
+        payload += std::string(names[i]) + "=" + string_from_float(point.values[i], decimals[i]) + ",";
+    if (!payload.empty() && payload.back() == ',')
+        payload.erase(payload.size() - 1);
+    return payload;
+}
+
+static size_t build_with_writer(const Point& point, char* buffer, size_t capacity)
+{
+    PayloadWriter payload(buffer, capacity);
+    payload.append("weather ");
+    for (int i = 0; i < 11; i++) {
+        if (i > 0)
+            payload.append(',');
+        payload.append(names[i]).append('=').append(point.values[i], decimals[i]);
+    }
+    return payload.length();
+}
+
+template <typename Function> static double time_ns_per_call(size_t calls, Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < calls; i++)
+        function(i);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> spread(-50.0f, 1100.0f);
+    std::vector<float> values(count);
+    for (float& value : values)
+        value = spread(random);
+
+    // format_fixed against printf
+    char text[64];
+    volatile size_t sink = 0;
+    double printf_ns = time_ns_per_call(count, [&](size_t i) { sink = sink + snprintf(text, sizeof(text), "%.2f", values[i]); });
+    double fixed_ns = time_ns_per_call(count, [&](size_t i) { sink = sink + format_fixed(text, values[i], 2); });
+
+    size_t mismatches = 0;
+    for (float value : values) {
+        char expected[64];
+        snprintf(expected, sizeof(expected), "%.2f", value);
+        size_t length = format_fixed(text, value, 2);
+        if (length != strlen(expected) || memcmp(text, expected, length) != 0)
+            mismatches++;
+    }
+
+    // full line protocol point
+    std::vector<Point> points(count / 10 + 1);
+    for (Point& point : points)
+        for (float& value : point.values)
+            value = spread(random);
+
+    size_t before = allocations;
+    double strings_ns = time_ns_per_call(points.size(), [&](size_t i) { sink = sink + build_with_strings(points[i]).size(); });
+    double strings_allocations = double(allocations - before) / points.size();
+
+    char buffer[320];
+    before = allocations;
+    double writer_ns = time_ns_per_call(points.size(), [&](size_t i) { sink = sink + build_with_writer(points[i], buffer, sizeof(buffer)); });
+    double writer_allocations = double(allocations - before) / points.size();
+
+    printf("float formatting, %zu values, 2 decimals\n", count);
+    printf("  snprintf       %8.1f ns/value\n", printf_ns);
+    printf("  format_fixed   %8.1f ns/value  (%.1fx, %zu last-digit differences)\n", fixed_ns, printf_ns / fixed_ns, mismatches);
+    printf("line protocol point, 11 fields, %zu points\n", points.size());
+    printf("  String chain   %8.1f ns/point  %5.1f allocations/point\n", strings_ns, strings_allocations);
+    printf("  PayloadWriter  %8.1f ns/point  %5.1f allocations/point\n", writer_ns, writer_allocations);
+    return 0;
+}
@@ -0,0 +1,309 @@
+/**
+ * Host-side benchmark of complete wake cycles
+ *
+ * Runs the firmware's setup() against the mocks in lib/native_hal for a number of
+ * simulated wake cycles. Every cycle starts from RTC memory only, as after a real
+ * deep sleep, and time is virtual, so a day of operation takes a few seconds.
+ * Reported per cycle: active time, radio-on time, estimated charge drawn, heap
+ * allocations and peak heap use, bytes sent, HTTP requests, TCP connections and
+ * TLS handshakes, and points written to InfluxDB, and how far the station's
+ * clock is off and how often it is synchronized. Then the heap use of each wake
+ * phase and the smallest largest free block it left (heap_stats.h); the bench
+ * fails, with exit status 1, if a phase made more allocations of its own than its
+ * budget in any cycle (test/test_heap checks the same). LittleFS lives in a temporary
+ * directory for the run.
+ *
+ * The firmware is built with the project's include/env.h.
+ *
+ * Build and run with PlatformIO:
+ *     pio run -e native && .pio/build/native/program [options]
+ *
+ * Options:
+ *     -n CYCLES       number of wake cycles to simulate (default 2000)
+ *     -v              print one line per cycle
+ *     -e              echo the serial output
+ *     --http-ms MS    server response time (default 250)
+ *     --uplink-kbps R transmit HTTP requests at R kbit/s (default: no airtime)
+ *     --no-wifi       the access point is unreachable
+ *     --outage H:H    the access point is unreachable from hour H to hour H of the run
+ *     --no-flash      the board has no LittleFS partition
+ *     --battery V     battery voltage (default 3.95)
+ *     --drift-ppm PPM the RTC runs this much fast in deep sleep (negative: slow)
+ *     --seed N        seed of the sensor noise
+ *     --no-ack        the collector does not acknowledge datagrams
+ *     --missing NAME  the sensor is not fitted: bmp280, aht20, bh1750, ads1115 or sps30 (repeatable)
+ *     --bmp280-alt    the BMP280 is strapped to its alternative address 0x76
+ *     --no-pm         the SDK has no power management: the CPU idles at full clock
+ *     --no-light-sleep the SDK has no automatic light sleep, only frequency scaling
+ */
+
+// `pio test -e native` links the firmware with the tests in test/, which bring their own main()
+#ifndef PIO_UNIT_TESTING
+
+#include "Arduino.h"
+#include "collector_packet.h"
+#include "heap_stats.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+
+/**
+ * Heap use per phase of the last wake; RTC memory is what the wake's process hands back
+ */
+RTC_DATA_ATTR HeapPhaseStats wake_heap[PERF_PHASE_COUNT];
+
+static void setup_with_heap_stats()
+{
+    try {
+        setup();
+    } catch (...) {
+        // deep sleep or restart
+        for (uint8_t phase = 0; phase < PERF_PHASE_COUNT; phase++)
+            wake_heap[phase] = heap_phase_stats((PerfPhase)phase);
+        throw;
+    }
+}
+
+struct PhaseHeapSummary {
+    uint64_t allocations = 0;
+    uint16_t max_allocations = 0;
+    uint32_t max_allocated_bytes = 0;
+    uint32_t max_peak_bytes = 0;
+    uint32_t min_largest_free_block = UINT32_MAX;
+    uint32_t cycles_over_budget = 0;
+};
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [-n CYCLES] [-v] [-e] [--http-ms MS] [--uplink-kbps R] [--no-wifi] [--outage H:H] [--no-flash] [--battery V] [--drift-ppm PPM] [--seed N] [--no-ack] [--missing NAME] [--bmp280-alt] [--no-pm] [--no-light-sleep]\n", program);
+    exit(2);
+}
+
+/**
+ * Plays the local collector: acknowledges every valid datagram that asks for it
+ */
+static size_t collector_responder(const uint8_t* datagram, size_t length, uint8_t* reply, size_t capacity)
+{
+    CollectorPacket packet;
+    if (!collector_decode(datagram, length, packet) || !(packet.flags & COLLECTOR_FLAG_ACK_REQUESTED))
+        return 0;
+    return collector_encode_ack(reply, capacity, packet.station_id, packet.boot, packet.sequence);
+}
+
+static void remove_directory(const char* path)
+{
+    DIR* directory = opendir(path);
+    while (dirent* entry = directory ? readdir(directory) : nullptr)
+        if (entry->d_name[0] != '.')
+            unlink((std::string(path) + "/" + entry->d_name).c_str());
+    if (directory)
+        closedir(directory);
+    rmdir(path);
+}
+
+/**
+ * Charge drawn by the ESP32 in a wake cycle in mAs, from typical currents of its
+ * datasheet: CPU at 240 MHz, CPU at 80 MHz, light sleep, and what the radio adds
+ * while it is on. Sensors and the SPS30 fan are not included.
+ */
+static double charge(const sim::WakeStats& stats)
+{
+    const double full_clock_ma = 40, low_clock_ma = 20, light_sleep_ma = 0.8, radio_ma = 80;
+    uint64_t full_clock_us = stats.active_us - stats.low_clock_us - stats.light_sleep_us;
+    return (full_clock_us * full_clock_ma + stats.low_clock_us * low_clock_ma + stats.light_sleep_us * light_sleep_ma
+               + stats.radio_on_us * radio_ma)
+        / 1e6;
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(fraction * (values.size() - 1) + 0.5)];
+}
+
+int main(int argc, char** argv)
+{
+    sim::Config& config = sim::config();
+    int cycles = 2000;
+    bool verbose = false;
+    bool use_flash = true;
+    config.udp_responder = collector_responder;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-n") == 0 && has_value)
+            cycles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else if (strcmp(argv[i], "-e") == 0)
+            config.echo_serial = true;
+        else if (strcmp(argv[i], "--http-ms") == 0 && has_value)
+            config.http_response_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--uplink-kbps") == 0 && has_value)
+            config.uplink_kbps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-wifi") == 0)
+            config.wifi_available = false;
+        else if (strcmp(argv[i], "--outage") == 0 && has_value) {
+            double from_h = 0, to_h = 0;
+            if (sscanf(argv[++i], "%lf:%lf", &from_h, &to_h) != 2 || to_h <= from_h)
+                usage(argv[0]);
+            config.outage_start_s = (uint32_t)(from_h * 3600);
+            config.outage_end_s = (uint32_t)(to_h * 3600);
+        } else if (strcmp(argv[i], "--no-flash") == 0)
+            use_flash = false;
+        else if (strcmp(argv[i], "--battery") == 0 && has_value)
+            config.battery_voltage = atof(argv[++i]);
+        else if (strcmp(argv[i], "--drift-ppm") == 0 && has_value)
+            config.rtc_drift_ppm = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value)
+            config.seed = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-ack") == 0)
+            config.udp_responder = nullptr;
+        else if (strcmp(argv[i], "--missing") == 0 && has_value) {
+            const char* name = argv[++i];
+            bool* present = strcmp(name, "bmp280") == 0 ? &config.bmp280_present
+                : strcmp(name, "aht20") == 0            ? &config.aht20_present
+                : strcmp(name, "bh1750") == 0           ? &config.bh1750_present
+                : strcmp(name, "ads1115") == 0          ? &config.ads1115_present
+                : strcmp(name, "sps30") == 0            ? &config.sps30_present
+                                                        : nullptr;
+            if (!present)
+                usage(argv[0]);
+            *present = false;
+        } else if (strcmp(argv[i], "--bmp280-alt") == 0)
+            config.bmp280_address = 0x76;
+        else if (strcmp(argv[i], "--no-pm") == 0)
+            config.power_management = false;
+        else if (strcmp(argv[i], "--no-light-sleep") == 0)
+            config.light_sleep = false;
+        else
+            usage(argv[0]);
+    }
+    if (cycles <= 0)
+        usage(argv[0]);
+
+    char flash_dir[] = "/tmp/wake_bench.XXXXXX";
+    if (use_flash) {
+        if (!mkdtemp(flash_dir)) {
+            perror("wake_bench: mkdtemp");
+            return 1;
+        }
+        config.flash_dir = flash_dir;
+    }
+
+    std::vector<double> active_s, radio_s, charge_mas, first_i2c_ms, clock_error_ms;
+    uint64_t sntp_syncs = 0, allocations = 0, allocated_bytes = 0, bytes_sent = 0, requests = 0, connections = 0, tls_handshakes = 0;
+    uint64_t points_written = 0, sleep_us = 0;
+    uint32_t peak_heap = 0, restarts = 0;
+    PhaseHeapSummary phase_heap[PERF_PHASE_COUNT];
+
+    for (int i = 0; i < cycles; i++) {
+        sim::WakeStats stats = sim::run_wake(setup_with_heap_stats);
+        active_s.push_back(stats.active_us / 1e6);
+        radio_s.push_back(stats.radio_on_us / 1e6);
+        charge_mas.push_back(charge(stats));
+        first_i2c_ms.push_back(stats.first_i2c_us / 1e3);
+        if (stats.clock_synchronized)
+            clock_error_ms.push_back(std::abs(stats.clock_error_us) / 1e3);
+        sntp_syncs += stats.sntp_syncs;
+        allocations += stats.allocations;
+        allocated_bytes += stats.allocated_bytes;
+        bytes_sent += stats.bytes_sent;
+        requests += stats.requests;
+        connections += stats.connections;
+        tls_handshakes += stats.tls_handshakes;
+        points_written += stats.points_written;
+        sleep_us += stats.sleep_us;
+        peak_heap = std::max(peak_heap, stats.peak_heap_bytes);
+        restarts += stats.restarted;
+        for (uint8_t phase = 0; phase < PERF_PHASE_COUNT; phase++) {
+            const HeapPhaseStats& heap = wake_heap[phase];
+            PhaseHeapSummary& summary = phase_heap[phase];
+            summary.allocations += heap.allocations;
+            summary.max_allocations = std::max(summary.max_allocations, heap.allocations);
+            summary.max_allocated_bytes = std::max(summary.max_allocated_bytes, heap.allocated_bytes);
+            summary.max_peak_bytes = std::max(summary.max_peak_bytes, heap.peak_bytes);
+            if (heap.largest_free_block != 0)
+                summary.min_largest_free_block = std::min(summary.min_largest_free_block, heap.largest_free_block);
+            summary.cycles_over_budget += heap.own_allocations > heap_allocation_budget((PerfPhase)phase);
+        }
+
+        if (verbose)
+            printf("wake %5d  active %7.3f s  radio %6.3f s  allocs %4u  peak heap %6u B  sent %6u B  requests %u  points %u%s\n",
+                i, stats.active_us / 1e6, stats.radio_on_us / 1e6, stats.allocations, stats.peak_heap_bytes, stats.bytes_sent,
+                stats.requests, stats.points_written, stats.restarted ? "  RESTART" : "");
+    }
+
+    double total_active = 0, total_radio = 0, total_charge = 0, total_first_i2c = 0;
+    for (int i = 0; i < cycles; i++) {
+        total_active += active_s[i];
+        total_radio += radio_s[i];
+        total_charge += charge_mas[i];
+        total_first_i2c += first_i2c_ms[i];
+    }
+
+    printf("%d wake cycles, %.1f simulated hours\n", cycles, (total_active + sleep_us / 1e6) / 3600);
+    printf("                        mean       p50       p95       max\n");
+    printf("active time [s]    %9.3f %9.3f %9.3f %9.3f\n", total_active / cycles, percentile(active_s, 0.5),
+        percentile(active_s, 0.95), percentile(active_s, 1.0));
+    printf("radio-on time [s]  %9.3f %9.3f %9.3f %9.3f\n", total_radio / cycles, percentile(radio_s, 0.5),
+        percentile(radio_s, 0.95), percentile(radio_s, 1.0));
+    printf("charge [mAs]       %9.2f %9.2f %9.2f %9.2f\n", total_charge / cycles, percentile(charge_mas, 0.5),
+        percentile(charge_mas, 0.95), percentile(charge_mas, 1.0));
+    printf("first I2C [ms]     %9.1f %9.1f %9.1f %9.1f\n", total_first_i2c / cycles, percentile(first_i2c_ms, 0.5),
+        percentile(first_i2c_ms, 0.95), percentile(first_i2c_ms, 1.0));
+    double total_clock_error = 0;
+    for (double error_ms : clock_error_ms)
+        total_clock_error += error_ms;
+    printf("clock error [ms]   %9.1f %9.1f %9.1f %9.1f\n", clock_error_ms.empty() ? 0 : total_clock_error / clock_error_ms.size(),
+        percentile(clock_error_ms, 0.5), percentile(clock_error_ms, 0.95), percentile(clock_error_ms, 1.0));
+    printf("SNTP syncs         %9.3f (%llu in total)\n", (double)sntp_syncs / cycles, (unsigned long long)sntp_syncs);
+    printf("allocations        %9.1f\n", (double)allocations / cycles);
+    printf("allocated bytes    %9.1f\n", (double)allocated_bytes / cycles);
+    printf("peak heap [B]      %9u (max)\n", peak_heap);
+    printf("bytes sent         %9.1f\n", (double)bytes_sent / cycles);
+    printf("HTTP requests      %9.2f\n", (double)requests / cycles);
+    printf("TCP connections    %9.2f\n", (double)connections / cycles);
+    printf("TLS handshakes     %9.2f (%llu in total)\n", (double)tls_handshakes / cycles, (unsigned long long)tls_handshakes);
+    printf("InfluxDB points    %9.2f (%llu in total)\n", (double)points_written / cycles, (unsigned long long)points_written);
+    printf("restarts           %9u\n", restarts);
+
+    printf("\nheap per phase      allocations  max allocations  max bytes  max peak [B]  min largest block [B]  budget\n");
+    bool over_budget = false;
+    for (uint8_t phase = 0; phase < PERF_PHASE_COUNT; phase++) {
+        const PhaseHeapSummary& summary = phase_heap[phase];
+        uint16_t budget = heap_allocation_budget((PerfPhase)phase);
+        if (summary.min_largest_free_block == UINT32_MAX && budget == HEAP_NO_BUDGET)
+            continue; // never ran
+        char budget_text[8] = "-", largest_text[12] = "-";
+        if (budget != HEAP_NO_BUDGET)
+            snprintf(budget_text, sizeof(budget_text), "%u", budget);
+        if (summary.min_largest_free_block != UINT32_MAX)
+            snprintf(largest_text, sizeof(largest_text), "%u", summary.min_largest_free_block);
+        printf("%-18s %12.2f %16u %10u %13u %22s  %6s\n", perf_phase_name((PerfPhase)phase),
+            (double)summary.allocations / cycles, summary.max_allocations, summary.max_allocated_bytes, summary.max_peak_bytes,
+            largest_text, budget_text);
+        over_budget |= summary.cycles_over_budget > 0;
+    }
+    for (uint8_t phase = 0; phase < PERF_PHASE_COUNT; phase++)
+        if (phase_heap[phase].cycles_over_budget > 0)
+            printf("FAIL: %s over its allocation budget of %u in %u cycles\n", perf_phase_name((PerfPhase)phase),
+                heap_allocation_budget((PerfPhase)phase), phase_heap[phase].cycles_over_budget);
+
+    if (use_flash)
+        remove_directory(flash_dir);
+    return over_budget ? 1 : 0;
+}
+
+#endif // PIO_UNIT_TESTING